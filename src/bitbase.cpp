@@ -16,11 +16,21 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <atomic>
 #include <cassert>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <bitset>
 
 #include "bitboard.h"
+#include "movegen.h"
+#include "position.h"
+#include "thread.h"
 #include "types.h"
 
 namespace {
@@ -48,7 +58,8 @@ namespace {
     INVALID = 0,
     UNKNOWN = 1,
     DRAW    = 2,
-    WIN     = 4
+    WIN     = 4,
+    LOSS    = 8
   };
 
   Result& operator|=(Result& r, Result v) { return r = Result(r | v); }
@@ -64,6 +75,55 @@ namespace {
     Result result;
   };
 
+  // Variant bitbases are generated for small material configurations of any
+  // variant by playing out all positions with the regular move generator. An
+  // index is built from the side to move and the squares of the pieces, in
+  // the order of VariantBitbase::pieces:
+  //
+  // bit     0: side to move (WHITE or BLACK)
+  // bit  1- 6: square of the first piece
+  // bit  7-12: square of the second piece
+  // bit 13-18: square of the third piece
+  //
+  // Results are stored with 2 bits per position from the point of view of
+  // the side to move: 0 for draw (or invalid), 1 for win, 2 for loss and 3
+  // when the result depends on a material without a registered bitbase.
+  constexpr int MAX_PIECES = 3;
+
+  struct VariantBitbase {
+    std::string code;
+    Variant variant;
+    Color strongSide;
+    int pieceCnt;
+    Piece pieces[MAX_PIECES];
+    std::atomic<bool> ready[SUBVARIANT_NB];
+    std::vector<uint8_t> table[SUBVARIANT_NB];
+  };
+
+  // Builder is the thread that loads or builds the variant bitbases, so that a
+  // search never waits for them: until its table is ready, an endgame falls
+  // back to its heuristic evaluation.
+  class Builder : public Thread {
+
+  public:
+    Builder() : Thread(0) {}
+   ~Builder() { abort = true; wait_for_search_finished(); }
+    void search() override;
+
+    std::mutex mutex;
+    std::deque<std::pair<VariantBitbase*, Variant>> queue;
+    bool busy = false;
+    std::atomic<bool> abort{false}; // Set on exit, the table is then left unbuilt
+  };
+
+  std::unordered_map<Key, std::unique_ptr<VariantBitbase>> VariantBitbases;
+  std::string BitbasePath; // Guarded by PathMutex, the builder reads a copy
+  std::mutex PathMutex;
+  std::unique_ptr<Builder> TheBuilder;
+
+  bool build_table(VariantBitbase& bb, Variant sv, Thread* th);
+  Result probe_table(const VariantBitbase& bb, const Position& pos);
+
 } // namespace
 
 
@@ -75,6 +135,95 @@ bool Bitbases::probe(Square wksq, Square wpsq, Square bksq, Color stm) {
 }
 
 
+/// Bitbases::add() registers a variant bitbase for the material of the given
+/// endgame code, for both colors. Tables are built by Bitbases::prepare().
+
+void Bitbases::add(const std::string& code, Variant v) {
+
+  for (Color c : { WHITE, BLACK })
+  {
+      StateInfo st;
+      Position pos;
+      pos.set(code, c, v, &st);
+
+      auto bb = std::make_unique<VariantBitbase>();
+      bb->code = code;
+      bb->variant = v;
+      bb->strongSide = c;
+      bb->pieceCnt = popcount(pos.pieces());
+
+      assert(bb->pieceCnt <= MAX_PIECES);
+
+      int n = 0;
+      for (Color c2 : { WHITE, BLACK })
+          for (PieceType pt = PAWN; pt <= KING; ++pt)
+              for (int cnt = popcount(pos.pieces(c2, pt)); cnt > 0; --cnt)
+                  bb->pieces[n++] = make_piece(c2, pt);
+
+      VariantBitbases[pos.material_key()] = std::move(bb);
+  }
+}
+
+
+/// Bitbases::set_path() sets the directory where variant bitbases are cached
+/// after being built, so that they are only computed once.
+
+void Bitbases::set_path(const std::string& path) {
+
+  std::lock_guard<std::mutex> lk(PathMutex);
+  BitbasePath = path == "<empty>" ? "" : path;
+}
+
+
+/// Bitbases::prepare() starts loading or building, in the background, the
+/// tables of the given variant that are not ready yet. It is called on
+/// "isready", "ucinewgame" and when BitbasePath is set.
+
+void Bitbases::prepare(Variant v) {
+
+  if (!TheBuilder)
+      TheBuilder = std::make_unique<Builder>();
+
+  bool start = false;
+  {
+      std::lock_guard<std::mutex> lk(TheBuilder->mutex);
+
+      for (auto& it : VariantBitbases)
+          if (it.second->variant == main_variant(v) && !it.second->ready[v])
+              TheBuilder->queue.emplace_back(it.second.get(), v);
+
+      if (!TheBuilder->queue.empty() && !TheBuilder->busy)
+          TheBuilder->busy = start = true;
+  }
+
+  if (start)
+  {
+      TheBuilder->wait_for_search_finished(); // Still returning from a previous run
+      TheBuilder->start_searching();
+  }
+}
+
+
+/// Bitbases::probe() returns the result of a position whose material has a
+/// registered variant bitbase, from the point of view of the side to move, or
+/// VALUE_NONE if its table is not ready yet or the position is not computable.
+
+Value Bitbases::probe(const Position& pos) {
+
+  auto it = VariantBitbases.find(pos.material_key());
+
+  assert(it != VariantBitbases.end());
+
+  if (!it->second->ready[pos.subvariant()].load(std::memory_order_acquire))
+      return VALUE_NONE;
+
+  Result r = probe_table(*it->second, pos);
+  return  r == WIN     ?  VALUE_KNOWN_WIN
+        : r == LOSS    ? -VALUE_KNOWN_WIN
+        : r == UNKNOWN ?  VALUE_NONE : VALUE_DRAW;
+}
+
+
 void Bitbases::init() {
 
   std::vector<KPKPosition> db(MAX_INDEX);
@@ -167,4 +316,309 @@ namespace {
     return result = r & Good  ? Good  : r & UNKNOWN ? UNKNOWN : Bad;
   }
 
+
+  Result flip(Result r) {
+    return r == WIN ? LOSS : r == LOSS ? WIN : r;
+  }
+
+  unsigned index(const VariantBitbase& bb, const Position& pos) {
+
+    unsigned idx = pos.side_to_move();
+    Bitboard b = 0;
+
+    // Pieces of the same kind are indexed by increasing square
+    for (int i = 0; i < bb.pieceCnt; ++i)
+    {
+        if (i == 0 || bb.pieces[i] != bb.pieces[i - 1])
+            b = pos.pieces(color_of(bb.pieces[i]), type_of(bb.pieces[i]));
+
+        idx |= unsigned(pop_lsb(&b)) << (1 + 6 * i);
+    }
+
+    return idx;
+  }
+
+  std::string bitbase_path() {
+
+    std::lock_guard<std::mutex> lk(PathMutex);
+    return BitbasePath;
+  }
+
+  std::string file_name(const std::string& path, const VariantBitbase& bb, Variant sv) {
+    return path + "/" + variants[sv] + "-" + bb.code + (bb.strongSide == WHITE ? "-w" : "-b") + ".bin";
+  }
+
+  // terminal() returns the result of a position without legal moves or where
+  // the game ended by a variant rule, and UNKNOWN otherwise.
+  Result terminal(const Position& pos) {
+
+    Value v =  pos.is_variant_end()        ? pos.variant_result()
+             : MoveList<LEGAL>(pos).size() ? VALUE_NONE
+             : pos.checkers()              ? pos.checkmate_value()
+                                           : pos.stalemate_value();
+
+    return  v == VALUE_NONE ? UNKNOWN
+          : v > VALUE_DRAW  ? WIN
+          : v < VALUE_DRAW  ? LOSS : DRAW;
+  }
+
+  // decode() returns the piece placement part of the FEN of the position with
+  // the given index, or an empty string if the pieces can not be placed so.
+  std::string decode(const VariantBitbase& bb, unsigned idx) {
+
+    Piece board[SQUARE_NB] = {};
+
+    for (int i = 0; i < bb.pieceCnt; ++i)
+    {
+        Square s = Square((idx >> (1 + 6 * i)) & 0x3F);
+
+        if (   board[s] != NO_PIECE
+            || (type_of(bb.pieces[i]) == PAWN && (rank_of(s) == RANK_1 || rank_of(s) == RANK_8))
+            || (i > 0 && bb.pieces[i] == bb.pieces[i - 1] && s < Square((idx >> (6 * i - 5)) & 0x3F)))
+            return std::string();
+
+        board[s] = bb.pieces[i];
+    }
+
+    std::string fen;
+    for (Rank r = RANK_8; r >= RANK_1; --r)
+    {
+        int emptyCnt = 0;
+        for (File f = FILE_A; f <= FILE_H; ++f)
+            if (board[make_square(f, r)] == NO_PIECE)
+                ++emptyCnt;
+            else
+            {
+                if (emptyCnt)
+                    fen += char('0' + emptyCnt);
+                fen += " PNBRQK  pnbrqk"[board[make_square(f, r)]];
+                emptyCnt = 0;
+            }
+        if (emptyCnt)
+            fen += char('0' + emptyCnt);
+        if (r > RANK_1)
+            fen += '/';
+    }
+
+    return fen;
+  }
+
+  // build() generates the table of a variant bitbase. All positions are set up
+  // and their legal moves are split into the ones staying in the table and the
+  // ones leaving it (captures, promotions and game ends), which are resolved
+  // right away. Then, as for KPK, we iterate until no unknown position changes.
+  // An exit to a material without a registered bitbase can not be resolved, so
+  // it stays unknown and the positions depending on it are not computable.
+  // Returns false if the engine exits before the table is complete.
+  bool build(VariantBitbase& bb, Variant sv, Thread* th) {
+
+    const unsigned size = 2U << (6 * bb.pieceCnt);
+    const uint64_t nodes = th->nodes;
+    std::vector<uint8_t> db(size, INVALID), exits(size, INVALID);
+    std::vector<unsigned> offset(size + 1), succ;
+    StateInfo st[COLOR_NB], st2;
+    Position pos[COLOR_NB];
+
+    for (unsigned idx = 0; idx < size; idx += 2)
+    {
+        if (TheBuilder->abort)
+            return false;
+
+        offset[idx] = offset[idx + 1] = unsigned(succ.size());
+        std::string fen = decode(bb, idx);
+
+        if (fen.empty())
+            continue;
+
+        for (Color c : { WHITE, BLACK })
+            pos[c].set(fen + (c == WHITE ? " w - - 0 1" : " b - - 0 1"), false, sv, &st[c], th);
+
+        for (Color stm : { WHITE, BLACK })
+        {
+            Position& p = pos[stm];
+            Key key = p.material_key();
+            offset[idx + stm] = unsigned(succ.size());
+
+            // Invalid if the side that just moved is left in check
+            if (pos[~stm].checkers())
+                continue;
+
+#ifdef RACE
+            // Giving check is not allowed in racing kings
+            if (p.is_race() && p.checkers())
+                continue;
+#endif
+
+            Result r = terminal(p);
+            if (r != UNKNOWN)
+            {
+                db[idx + stm] = r;
+                continue;
+            }
+
+            Result e = INVALID;
+            for (const auto& m : MoveList<LEGAL>(p))
+            {
+                p.do_move(m, st2);
+
+                if (p.material_key() == key && !p.is_variant_end())
+                    succ.push_back(index(bb, p));
+                else
+                {
+                    auto it = VariantBitbases.find(p.material_key());
+                    r = terminal(p);
+                    if (r == UNKNOWN && it != VariantBitbases.end())
+                    {
+                        if (!build_table(*it->second, sv, th))
+                            return false;
+                        r = probe_table(*it->second, p);
+                    }
+                    e |= flip(r);
+                }
+
+                p.undo_move(m);
+            }
+
+            exits[idx + stm] = e;
+            db[idx + stm] =  e & WIN                            ? WIN
+                           : offset[idx + stm] != succ.size()   ? UNKNOWN
+                           : e & UNKNOWN                        ? UNKNOWN
+                           : e & DRAW                           ? DRAW : LOSS;
+        }
+    }
+    offset[size] = unsigned(succ.size());
+
+    // Iterate through the positions until none of the unknown positions can be
+    // changed to either wins, draws or losses.
+    for (bool repeat = true; repeat; )
+    {
+        if (TheBuilder->abort)
+            return false;
+
+        repeat = false;
+
+        for (unsigned idx = 0; idx < size; ++idx)
+            if (db[idx] == UNKNOWN)
+            {
+                Result r = Result(exits[idx]);
+
+                for (unsigned i = offset[idx]; i < offset[idx + 1]; ++i)
+                    r |= flip(Result(db[succ[i]]));
+
+                db[idx] =  r & WIN     ? WIN
+                         : r & UNKNOWN ? UNKNOWN
+                         : r & DRAW    ? DRAW : LOSS;
+
+                repeat |= db[idx] != UNKNOWN;
+            }
+    }
+
+    // What is left unknown is a draw, unless it has an unresolved exit or can
+    // move to a position that is not computable.
+    std::vector<bool> open(size);
+    for (unsigned idx = 0; idx < size; ++idx)
+        open[idx] = db[idx] == UNKNOWN && (exits[idx] & UNKNOWN);
+
+    for (bool repeat = true; repeat; )
+    {
+        repeat = false;
+
+        for (unsigned idx = 0; idx < size; ++idx)
+            if (db[idx] == UNKNOWN && !open[idx])
+                for (unsigned i = offset[idx]; i < offset[idx + 1]; ++i)
+                    if (open[succ[i]])
+                    {
+                        open[idx] = repeat = true;
+                        break;
+                    }
+    }
+
+    // Fill the bitbase with the decisive and the not computable results
+    std::vector<uint8_t>& table = bb.table[sv];
+    table.assign(size / 4, 0);
+    for (unsigned idx = 0; idx < size; ++idx)
+        if (db[idx] == WIN || db[idx] == LOSS || open[idx])
+            table[idx / 4] |= (db[idx] == WIN ? 1 : db[idx] == LOSS ? 2 : 3) << (2 * (idx % 4));
+
+    // Building is not part of the search, so do not count its nodes
+    th->nodes = nodes;
+    return true;
+  }
+
+  bool load(VariantBitbase& bb, Variant sv) {
+
+    std::string path = bitbase_path();
+    if (path.empty())
+        return false;
+
+    std::ifstream file(file_name(path, bb, sv), std::ios::binary);
+    std::vector<uint8_t>& table = bb.table[sv];
+    table.resize((2U << (6 * bb.pieceCnt)) / 4);
+
+    if (   !file.read(reinterpret_cast<char*>(table.data()), table.size())
+        || file.peek() != EOF)
+    {
+        table.clear();
+        return false;
+    }
+
+    return true;
+  }
+
+  void save(const VariantBitbase& bb, Variant sv) {
+
+    std::string path = bitbase_path();
+    if (path.empty())
+        return;
+
+    std::ofstream file(file_name(path, bb, sv), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bb.table[sv].data()), bb.table[sv].size());
+  }
+
+  // build_table() loads or builds a table, only from the builder thread
+  bool build_table(VariantBitbase& bb, Variant sv, Thread* th) {
+
+    if (bb.ready[sv])
+        return true;
+
+    if (!load(bb, sv))
+    {
+        if (!build(bb, sv, th))
+            return false;
+        save(bb, sv);
+    }
+
+    bb.ready[sv].store(true, std::memory_order_release);
+    return true;
+  }
+
+  Result probe_table(const VariantBitbase& bb, const Position& pos) {
+
+    Variant sv = pos.subvariant();
+    unsigned idx = index(bb, pos);
+    int r = (bb.table[sv][idx / 4] >> (2 * (idx % 4))) & 3;
+
+    return r == 1 ? WIN : r == 2 ? LOSS : r == 3 ? UNKNOWN : DRAW;
+  }
+
+  void Builder::search() {
+
+    while (true)
+    {
+        std::pair<VariantBitbase*, Variant> job;
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+
+            if (queue.empty())
+            {
+                busy = false;
+                return;
+            }
+            job = queue.front();
+            queue.pop_front();
+        }
+        build_table(*job.first, job.second, this);
+    }
+  }
+
 } // namespace
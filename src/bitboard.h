@@ -19,15 +19,23 @@
 #ifndef BITBOARD_H_INCLUDED
 #define BITBOARD_H_INCLUDED
 
+#include <array>
 #include <string>
 
 #include "types.h"
 
+class Position;
+
 namespace Bitbases {
 
 void init();
 bool probe(Square wksq, Square wpsq, Square bksq, Color us);
 
+void add(const std::string& code, Variant v);
+void set_path(const std::string& path);
+void prepare(Variant v);
+Value probe(const Position& pos);
+
 }
 
 namespace Bitboards {
@@ -72,13 +80,17 @@ constexpr Bitboard KingFlank[FILE_NB] = {
   KingSide, KingSide, KingSide ^ FileEBB
 };
 
-extern uint8_t PopCnt16[1 << 16];
-extern uint8_t SquareDistance[SQUARE_NB][SQUARE_NB];
+/// The tables below are computed at compile time, so that they are placed in
+/// read-only data and shared by all the engine processes running on a host.
+template<typename T, size_t N, size_t M> using Table2D = std::array<std::array<T, M>, N>;
+
+extern const std::array<uint8_t, 1 << 16> PopCnt16;
+extern const Table2D<uint8_t, SQUARE_NB, SQUARE_NB> SquareDistance;
 
-extern Bitboard SquareBB[SQUARE_NB];
-extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
-extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
+extern const std::array<Bitboard, SQUARE_NB> SquareBB;
+extern const Table2D<Bitboard, SQUARE_NB, SQUARE_NB> LineBB;
+extern const Table2D<Bitboard, PIECE_TYPE_NB, SQUARE_NB> PseudoAttacks;
+extern const Table2D<Bitboard, COLOR_NB, SQUARE_NB> PawnAttacks;
 #ifdef GRID
 extern Bitboard GridBB[GRIDLAYOUT_NB][SQUARE_NB];
 #endif
@@ -106,8 +118,8 @@ struct Magic {
   }
 };
 
-extern Magic RookMagics[SQUARE_NB];
-extern Magic BishopMagics[SQUARE_NB];
+extern const std::array<Magic, SQUARE_NB> RookMagics;
+extern const std::array<Magic, SQUARE_NB> BishopMagics;
 
 inline Bitboard square_bb(Square s) {
   assert(is_ok(s));
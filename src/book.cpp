@@ -0,0 +1,449 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "book.h"
+#include "misc.h"
+#include "position.h"
+#include "thread.h"
+#include "uci.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#  define NOMINMAX // Disable macros min() and max()
+#endif
+#include <windows.h>
+#endif
+
+namespace {
+
+// A book entry, with the games count in the "learn" field of Polyglot
+struct Entry {
+  Key key;
+  uint16_t move;
+  uint16_t weight;
+  uint32_t count;
+
+  bool operator<(const Entry& e) const { return key < e.key; }
+};
+
+static_assert(sizeof(Entry) == 16, "Book entry size incorrect");
+
+struct BookFile {
+  const Entry* entries;
+  size_t size;
+  void* baseAddress;
+  uint64_t mapping; // Mapped size
+#ifdef _WIN32
+  HANDLE handle;
+#endif
+};
+
+std::vector<BookFile> Files;
+
+#ifndef _WIN32
+constexpr char SepChar = ':';
+#else
+constexpr char SepChar = ';';
+#endif
+
+// map() memory maps a book file, returning false if it does not exist
+bool map(const std::string& fname, BookFile& f) {
+
+#ifndef _WIN32
+  struct stat statbuf;
+  int fd = ::open(fname.c_str(), O_RDONLY);
+
+  if (fd == -1)
+      return false;
+
+  fstat(fd, &statbuf);
+
+  if (!statbuf.st_size || statbuf.st_size % sizeof(Entry))
+  {
+      ::close(fd);
+      return false;
+  }
+
+  f.mapping = statbuf.st_size;
+  f.baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (f.baseAddress == MAP_FAILED)
+      return false;
+#else
+  HANDLE fd = CreateFile(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+  if (fd == INVALID_HANDLE_VALUE)
+      return false;
+
+  DWORD size_high;
+  DWORD size_low = GetFileSize(fd, &size_high);
+
+  if (size_high || !size_low || size_low % sizeof(Entry))
+  {
+      CloseHandle(fd);
+      return false;
+  }
+
+  HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
+  CloseHandle(fd);
+
+  if (!mmap)
+      return false;
+
+  f.handle = mmap;
+  f.mapping = size_low;
+  f.baseAddress = MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0);
+
+  if (!f.baseAddress)
+  {
+      CloseHandle(mmap);
+      return false;
+  }
+
+#endif
+
+  f.entries = (const Entry*)f.baseAddress;
+  f.size = size_t(f.mapping) / sizeof(Entry);
+  return true;
+}
+
+void unmap(BookFile& f) {
+
+#ifndef _WIN32
+  munmap(f.baseAddress, f.mapping);
+#else
+  UnmapViewOfFile(f.baseAddress);
+  CloseHandle(f.handle);
+#endif
+}
+
+// A game read from a PGN file, with the result from white's point of view
+struct PgnGame {
+  Variant variant;
+  bool chess960;
+  std::string fen;
+  std::vector<std::string> moves;
+  int result;
+};
+
+// read_pgn() reads the games of a PGN file, keeping the main line moves in SAN
+std::vector<PgnGame> read_pgn(std::istream& in) {
+
+  std::vector<PgnGame> games;
+  std::string line, text, name, value;
+  PgnGame game { CHESS_VARIANT, false, "", {}, 0 };
+  bool skip = false;
+
+  auto finish = [&]() {
+
+      int depth = 0;
+
+      for (size_t i = 0; i < text.size(); )
+      {
+          char c = text[i];
+
+          if (c == '{')
+              i = std::min(text.find('}', i), text.size()) + 1;
+          else if (c == ';')
+              i = std::min(text.find('\n', i), text.size());
+          else if (c == '(' || c == ')')
+              depth += c == '(' ? 1 : -1, ++i;
+          else if (isspace(c))
+              ++i;
+          else
+          {
+              size_t end = std::min(text.find_first_of(" \t\r\n{}();", i), text.size());
+              std::string token = text.substr(i, end - i);
+              i = end;
+
+              if (   depth
+                  || token[0] == '$' || token == "*"
+                  || token == "1-0" || token == "0-1" || token == "1/2-1/2")
+                  continue;
+
+              // Remove the move number, as in "12." or "12...Nf6"
+              token.erase(0, token.find_first_not_of("0123456789."));
+
+              if (!token.empty())
+                  game.moves.push_back(token);
+          }
+      }
+
+      if (!skip && !game.moves.empty())
+          games.push_back(game);
+
+      game = { CHESS_VARIANT, false, "", {}, 0 };
+      text.clear();
+      skip = false;
+  };
+
+  while (std::getline(in, line))
+  {
+      if (!line.empty() && line[0] == '[')
+      {
+          if (!text.empty())
+              finish();
+
+          size_t q1 = line.find('"'), q2 = line.rfind('"');
+          if (q1 == std::string::npos || q2 == q1)
+              continue;
+
+          std::istringstream(line.substr(1)) >> name;
+          value = line.substr(q1 + 1, q2 - q1 - 1);
+
+          if (name == "FEN")
+              game.fen = value;
+
+          else if (name == "Result")
+              game.result = value == "1-0" ? 1 : value == "0-1" ? -1 : 0;
+
+          else if (name == "Variant")
+          {
+              // Lichess names, as "Three-check" or "King of the Hill"
+              std::string v;
+              for (char c : value)
+                  if (isalnum(c))
+                      v += char(tolower(c));
+
+              game.chess960 = v == "chess960";
+
+              if (v == "threecheck")
+                  v = "3check";
+              else if (v == "standard" || v == "fromposition" || v == "chess960")
+                  v = "chess";
+
+              game.variant = UCI::variant_from_name(v);
+              skip = variants[game.variant] != v;
+          }
+      }
+      else
+          text += line + "\n";
+  }
+
+  if (!text.empty())
+      finish();
+
+  return games;
+}
+
+} // namespace
+
+
+/// Book::init() maps the book files in the given list of paths, separated as
+/// the SyzygyPath directories. Books of different variants can be used at
+/// the same time, since the variant is part of the key.
+
+void Book::init(const std::string& paths) {
+
+  for (BookFile& f : Files)
+      unmap(f);
+
+  Files.clear();
+
+  if (paths.empty() || paths == "<empty>")
+      return;
+
+  std::stringstream ss(paths);
+  std::string path;
+  size_t entries = 0;
+
+  while (std::getline(ss, path, SepChar))
+  {
+      BookFile f;
+
+      if (map(path, f))
+          Files.push_back(f), entries += f.size;
+      else
+          sync_cout << "info string Could not open book " << path << sync_endl;
+  }
+
+  sync_cout << "info string Found " << entries << " book entries" << sync_endl;
+}
+
+
+/// Book::probe() returns a book move for the given position, or MOVE_NONE.
+/// The move is chosen at random with a probability proportional to its weight,
+/// or is the one with the highest weight if bestMove is set.
+
+Move Book::probe(const Position& pos, bool bestMove) {
+
+  static PRNG rng(now());
+
+  Move move = MOVE_NONE;
+  unsigned sum = 0, best = 0;
+
+  for (const BookFile& f : Files)
+  {
+      auto range = std::equal_range(f.entries, f.entries + f.size, Entry{ pos.key(), 0, 0, 0 });
+
+      for (const Entry* e = range.first; e != range.second; ++e)
+      {
+          Move m = Move(e->move);
+
+          if (!e->weight || !pos.pseudo_legal(m) || !pos.legal(m))
+              continue;
+
+          sum += e->weight;
+
+          if (bestMove ? e->weight > best : rng.rand<unsigned>() % sum < e->weight)
+              move = m, best = e->weight;
+      }
+  }
+
+  return move;
+}
+
+
+/// Book::build() builds a book from the games of a PGN file. The command is:
+///
+///   makebook <pgn file> <book file> [plies N] [min N] [threads N]
+///
+/// and it adds the first plies (default 24) of each game, each move weighted
+/// with 2 points per game won and 1 point per game drawn by the side that
+/// played it, as Polyglot does. Moves played in less than min games (default
+/// 1) are dropped, and the games are replayed by all the cores.
+
+void Book::build(std::istream& is) {
+
+  std::string pgnFile, bookFile, token;
+  int maxPly = 24, minGames = 1;
+  int concurrency = std::max(1, int(std::thread::hardware_concurrency()));
+
+  is >> pgnFile >> bookFile;
+
+  while (is >> token)
+      if (token == "plies")        is >> maxPly;
+      else if (token == "min")     is >> minGames;
+      else if (token == "threads") is >> concurrency;
+
+  std::ifstream in(pgnFile);
+  if (!in || bookFile.empty())
+  {
+      sync_cout << "info string Could not read " << pgnFile << sync_endl;
+      return;
+  }
+
+  std::vector<PgnGame> games = read_pgn(in);
+
+  // Each thread replays its share of the games. The weight field holds the
+  // points and the count field the games, to be merged below.
+  std::vector<std::vector<Entry>> results(concurrency);
+  std::vector<std::thread> threads;
+  std::atomic<size_t> errors(0);
+
+  for (int t = 0; t < concurrency; ++t)
+      threads.emplace_back([&, t]() {
+
+          for (size_t i = t; i < games.size(); i += concurrency)
+          {
+              const PgnGame& g = games[i];
+              StateListPtr states(new std::deque<StateInfo>(1));
+              Position pos;
+
+              pos.set(g.fen.empty() ? UCI::start_fen(g.variant) : g.fen, g.chess960,
+                      g.variant, &states->back(), Threads.main());
+
+              for (int ply = 0; ply < maxPly && ply < int(g.moves.size()); ++ply)
+              {
+                  Move m = UCI::san_to_move(pos, g.moves[ply]);
+
+                  if (m == MOVE_NONE)
+                  {
+                      ++errors;
+                      break;
+                  }
+
+                  int points = 1 + (pos.side_to_move() == WHITE ? g.result : -g.result);
+                  results[t].push_back({ pos.key(), uint16_t(m), uint16_t(points), 1 });
+
+                  states->emplace_back();
+                  pos.do_move(m, states->back());
+              }
+          }
+      });
+
+  for (std::thread& th : threads)
+      th.join();
+
+  std::vector<Entry> all;
+  for (auto& r : results)
+      all.insert(all.end(), r.begin(), r.end()), r.clear(), r.shrink_to_fit();
+
+  std::sort(all.begin(), all.end(), [](const Entry& a, const Entry& b) {
+      return a.key != b.key ? a.key < b.key : a.move < b.move;
+  });
+
+  // Merge the duplicated moves, then scale down the weights of a position to
+  // fit in 16 bits, with the moves sorted by decreasing weight.
+  std::vector<Entry> book;
+  std::vector<uint64_t> points;
+
+  for (size_t i = 0, j; i < all.size(); i = j)
+  {
+      uint64_t sum = 0, count = 0;
+
+      for (j = i; j < all.size() && all[j].key == all[i].key && all[j].move == all[i].move; ++j)
+          sum += all[j].weight, count += all[j].count;
+
+      if (count >= uint64_t(minGames) && sum)
+      {
+          book.push_back({ all[i].key, all[i].move, 0, uint32_t(std::min(count, uint64_t(UINT32_MAX))) });
+          points.push_back(sum);
+      }
+  }
+
+  for (size_t i = 0, j; i < book.size(); i = j)
+  {
+      uint64_t maxPoints = 0;
+
+      for (j = i; j < book.size() && book[j].key == book[i].key; ++j)
+          maxPoints = std::max(maxPoints, points[j]);
+
+      for (size_t k = i; k < j; ++k)
+          book[k].weight = uint16_t(std::max(uint64_t(1), points[k] * std::min(maxPoints, uint64_t(65535)) / maxPoints));
+
+      std::stable_sort(book.begin() + i, book.begin() + j, [](const Entry& a, const Entry& b) {
+          return a.weight > b.weight;
+      });
+  }
+
+  std::ofstream out(bookFile, std::ios::binary);
+  out.write((const char*)book.data(), book.size() * sizeof(Entry));
+
+  sync_cout << "info string " << games.size() << " games, " << book.size() << " entries written to "
+            << bookFile << (errors ? ", " + std::to_string(errors) + " games with an illegal move" : "")
+            << sync_endl;
+}
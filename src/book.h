@@ -0,0 +1,44 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <iosfwd>
+#include <string>
+
+#include "types.h"
+
+class Position;
+
+/// The opening books are sorted arrays of 16 bytes entries, with the layout of
+/// the Polyglot books, but keyed by Position::key() so that the variant, the
+/// pieces in hand and the remaining checks are all part of the key. Since the
+/// Zobrist keys depend on the compiled variants, a book should be built by an
+/// engine with the same variants. Book files are memory mapped and read only,
+/// so several engine processes share the same pages.
+
+namespace Book {
+
+void init(const std::string& paths);
+Move probe(const Position& pos, bool bestMove);
+void build(std::istream& is);
+
+} // namespace Book
+
+#endif // #ifndef BOOK_H_INCLUDED
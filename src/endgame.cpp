@@ -87,17 +87,24 @@ namespace Endgames {
     add<CHESS_VARIANT, KRPPKRP>("KRPPvKRP");
 
 #ifdef ANTI
-    add<ANTI_VARIANT, RK>("RvK");
-    add<ANTI_VARIANT, KN>("KvN");
-    add<ANTI_VARIANT, NN>("NvN");
+    add_bitbase<ANTI_VARIANT, RK>("RvK");
+    add_bitbase<ANTI_VARIANT, KN>("KvN");
+    add_bitbase<ANTI_VARIANT, NN>("NvN");
 #endif
 #ifdef ATOMIC
-    add<ATOMIC_VARIANT, KPK>("KPvK");
+    add_bitbase<ATOMIC_VARIANT, KPK>("KPvK");
     add<ATOMIC_VARIANT, KNK>("KNvK");
     add<ATOMIC_VARIANT, KBK>("KBvK");
     add<ATOMIC_VARIANT, KRK>("KRvK");
-    add<ATOMIC_VARIANT, KQK>("KQvK");
+    add_bitbase<ATOMIC_VARIANT, KQK>("KQvK");
     add<ATOMIC_VARIANT, KNNK>("KNNvK");
+#endif
+#ifdef RACE
+    add_bitbase<RACE_VARIANT>("KvK");
+    add_bitbase<RACE_VARIANT>("KNvK");
+    add_bitbase<RACE_VARIANT>("KBvK");
+    add_bitbase<RACE_VARIANT>("KRvK");
+    add_bitbase<RACE_VARIANT>("KQvK");
 #endif
   }
 }
@@ -775,12 +782,35 @@ ScaleFactor Endgame<CHESS_VARIANT, KPKP>::operator()(const Position& pos) const
 }
 
 #ifdef ANTI
+/// Antichess endgames are scored from their bitbase, or VALUE_NONE while it is
+/// not ready. The winning side is rewarded for keeping its pieces close to the
+/// opponent's ones, so that it can force them to capture.
+template<>
+Value Endgame<ANTI_VARIANT, BITBASE>::operator()(const Position& pos) const {
+
+  assert(pos.variant() == ANTI_VARIANT);
+
+  Value result = Bitbases::probe(pos);
+
+  if (result == VALUE_NONE || result == VALUE_DRAW)
+      return result;
+
+  Color winner = result > 0 ? pos.side_to_move() : ~pos.side_to_move();
+  Value bonus = Value(push_close(lsb(pos.pieces(winner)), lsb(pos.pieces(~winner))));
+
+  return result > 0 ? result + bonus : result - bonus;
+}
+
 /// R vs K. The rook side always wins if there is no immediate forced capture.
 template<>
 Value Endgame<ANTI_VARIANT, RK>::operator()(const Position& pos) const {
 
   assert(pos.variant() == ANTI_VARIANT);
 
+  Value v = Endgame<ANTI_VARIANT, BITBASE>(strongSide)(pos);
+  if (v != VALUE_NONE)
+      return v;
+
   Square RSq = pos.square<ROOK>(strongSide);
   Square KSq = pos.square<KING>(weakSide);
 
@@ -805,6 +835,10 @@ Value Endgame<ANTI_VARIANT, KN>::operator()(const Position& pos) const {
 
   assert(pos.variant() == ANTI_VARIANT);
 
+  Value v = Endgame<ANTI_VARIANT, BITBASE>(strongSide)(pos);
+  if (v != VALUE_NONE)
+      return v;
+
   Square KSq = pos.square<KING>(strongSide);
   Square NSq = pos.square<KNIGHT>(weakSide);
 
@@ -826,6 +860,10 @@ Value Endgame<ANTI_VARIANT, NN>::operator()(const Position& pos) const {
 
   assert(pos.variant() == ANTI_VARIANT);
 
+  Value v = Endgame<ANTI_VARIANT, BITBASE>(strongSide)(pos);
+  if (v != VALUE_NONE)
+      return v;
+
   Square N1Sq = pos.square<KNIGHT>(pos.side_to_move());
   Square N2Sq = pos.square<KNIGHT>(~pos.side_to_move());
 
@@ -906,6 +944,33 @@ Value Endgame<ATOMIC_VARIANT, KXK>::operator()(const Position& pos) const {
   return strongSide == pos.side_to_move() ? result : -result;
 }
 
+/// Atomic endgames with a bitbase, or VALUE_NONE while it is not ready. The
+/// winning side is rewarded for driving the defending king towards the edge,
+/// while keeping the kings apart, and for advancing its pawn.
+template<>
+Value Endgame<ATOMIC_VARIANT, BITBASE>::operator()(const Position& pos) const {
+
+  assert(pos.variant() == ATOMIC_VARIANT);
+
+  Value result = Bitbases::probe(pos);
+
+  if (result == VALUE_NONE || result == VALUE_DRAW)
+      return result;
+
+  Color winner = result > 0 ? pos.side_to_move() : ~pos.side_to_move();
+  Square winnerKSq = pos.square<KING>(winner);
+  Square loserKSq = pos.square<KING>(~winner);
+
+  Value bonus =  pos.non_pawn_material(winner)
+               + push_to_edge(loserKSq)
+               + push_away(winnerKSq, loserKSq);
+
+  if (pos.count<PAWN>(winner))
+      bonus += PawnValueEgAtomic + 20 * relative_rank(winner, pos.square<PAWN>(winner));
+
+  return result > 0 ? result + bonus : result - bonus;
+}
+
 template<>
 Value Endgame<ATOMIC_VARIANT, KPK>::operator()(const Position& pos) const {
 
@@ -913,6 +978,10 @@ Value Endgame<ATOMIC_VARIANT, KPK>::operator()(const Position& pos) const {
   assert(verify_material(pos, strongSide, VALUE_ZERO, 1));
   assert(verify_material(pos, weakSide, VALUE_ZERO, 0));
 
+  Value v = Endgame<ATOMIC_VARIANT, BITBASE>(strongSide)(pos);
+  if (v != VALUE_NONE)
+      return v;
+
   Square winnerKSq = pos.square<KING>(strongSide);
   Square loserKSq = pos.square<KING>(weakSide);
 
@@ -928,12 +997,6 @@ Value Endgame<ATOMIC_VARIANT, KPK>::operator()(const Position& pos) const {
   return strongSide == pos.side_to_move() ? result : -result;
 }
 
-template<> Value Endgame<ATOMIC_VARIANT, KNK>::operator()(const Position&) const { return VALUE_DRAW; }
-
-template<> Value Endgame<ATOMIC_VARIANT, KBK>::operator()(const Position&) const { return VALUE_DRAW; }
-
-template<> Value Endgame<ATOMIC_VARIANT, KRK>::operator()(const Position&) const { return VALUE_DRAW; }
-
 template<>
 Value Endgame<ATOMIC_VARIANT, KQK>::operator()(const Position& pos) const {
 
@@ -941,6 +1004,10 @@ Value Endgame<ATOMIC_VARIANT, KQK>::operator()(const Position& pos) const {
   assert(verify_material(pos, weakSide, VALUE_ZERO, 0));
   assert(!pos.checkers()); // Eval is never called when in check
 
+  Value v = Endgame<ATOMIC_VARIANT, BITBASE>(strongSide)(pos);
+  if (v != VALUE_NONE)
+      return v;
+
   // Stalemate detection with lone king
   if (pos.side_to_move() == weakSide && !MoveList<LEGAL>(pos).size())
       return VALUE_DRAW;
@@ -965,5 +1032,33 @@ Value Endgame<ATOMIC_VARIANT, KQK>::operator()(const Position& pos) const {
   return strongSide == pos.side_to_move() ? result : -result;
 }
 
+template<> Value Endgame<ATOMIC_VARIANT, KNK>::operator()(const Position&) const { return VALUE_DRAW; }
+
+template<> Value Endgame<ATOMIC_VARIANT, KBK>::operator()(const Position&) const { return VALUE_DRAW; }
+
+template<> Value Endgame<ATOMIC_VARIANT, KRK>::operator()(const Position&) const { return VALUE_DRAW; }
+
 template<> Value Endgame<ATOMIC_VARIANT, KNNK>::operator()(const Position&) const { return VALUE_DRAW; }
 #endif
+
+#ifdef RACE
+/// Racing kings endgames with a bitbase. The winning side is rewarded for
+/// advancing its king. While the bitbase is not ready, VALUE_NONE lets the
+/// position be evaluated as if there were no endgame function.
+template<>
+Value Endgame<RACE_VARIANT, BITBASE>::operator()(const Position& pos) const {
+
+  assert(pos.variant() == RACE_VARIANT);
+
+  Value result = Bitbases::probe(pos);
+
+  if (result == VALUE_NONE || result == VALUE_DRAW)
+      return result;
+
+  Color winner = result > 0 ? pos.side_to_move() : ~pos.side_to_move();
+  Value bonus =  pos.non_pawn_material(winner)
+               + 20 * rank_of(pos.square<KING>(winner));
+
+  return result > 0 ? result + bonus : result - bonus;
+}
+#endif
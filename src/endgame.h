@@ -34,6 +34,7 @@
 enum EndgameCode {
 
   EVALUATION_FUNCTIONS,
+  BITBASE, // Exact result from a variant bitbase
 #ifdef ANTI
   RK,
   KN,
@@ -124,6 +125,15 @@ namespace Endgames {
     map<T>()[Position().set(code, BLACK, V, &st).material_key()] = Ptr<T>(new Endgame<V, E>(BLACK));
   }
 
+  // add_bitbase() registers a variant bitbase, with the endgame that scores it
+  // and evaluates the position with a heuristic until the table is ready.
+  template<Variant V, EndgameCode E = BITBASE>
+  void add_bitbase(const std::string& code) {
+
+    Bitbases::add(code, V);
+    add<V, E>(code);
+  }
+
   template<typename T>
   const EndgameBase<T>* probe(Key key) {
     auto it = map<T>().find(key);
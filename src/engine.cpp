@@ -0,0 +1,135 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+#include "bitboard.h"
+#include "endgame.h"
+#include "engine.h"
+#include "evaluate.h"
+#include "misc.h"
+#include "psqt.h"
+#include "thread.h"
+#include "tune.h"
+
+namespace {
+
+  std::mutex SearchMutex;                   // Held by the session searching
+  std::atomic<Engine::Session*> Searching;  // The session searching, if any
+
+} // namespace
+
+
+/// Engine::init() sets up the options and the tables of the engine, and starts
+/// the threads. It is called once, before any search or session is created.
+
+void Engine::init(int argc, char* argv[]) {
+
+  CommandLine::init(argc, argv);
+  UCI::init(Options);
+  Tune::init();
+
+  // Stages within a group only depend on the ones of the previous groups
+  Startup::run({ { "PSQT", PSQT::init },
+                 { "Bitboards", Bitboards::init } });
+  Startup::run({ { "Position", Position::init },
+                 { "Bitbases", Bitbases::init } });
+  Startup::run({ { "Endgames", Endgames::init } });
+  Startup::run({ { "Threads", [] { Threads.set(size_t(Options["Threads"])); } } });
+  Startup::run({ { "Search::clear", Search::clear } }); // After threads are up
+}
+
+
+namespace Engine {
+
+Session::Session(size_t hashMB) {
+
+  tt.resize(hashMB);
+  set_position("startpos");
+}
+
+
+/// Session::set_position() sets the position from a FEN string, or "startpos"
+/// for the starting position of the variant, followed by the given moves.
+
+void Session::set_position(const std::string& fen, Variant v, const std::vector<std::string>& moves, bool chess960) {
+
+  states = StateListPtr(new std::deque<StateInfo>(1));
+  pos.set(fen == "startpos" ? UCI::start_fen(v) : fen, chess960, v, &states->back(), Threads.main());
+
+  for (std::string m : moves)
+  {
+      Move move = UCI::to_move(pos, m);
+      if (move == MOVE_NONE)
+          break;
+
+      states->emplace_back();
+      pos.do_move(move, states->back());
+  }
+}
+
+
+/// Session::go() searches the current position and returns after the best move
+/// has been passed to onBestMove. The session transposition table is swapped
+/// in the global one for the time of the search.
+
+void Session::go(const Search::LimitsType& limits, InfoCallback onInfo, BestMoveCallback onBestMove) {
+
+  std::lock_guard<std::mutex> lk(SearchMutex);
+
+  Searching = this;
+  TT.swap(tt);
+  UCI::set_listeners(onInfo, onBestMove);
+
+  Search::LimitsType l = limits;
+  l.startTime = now(); // As early as possible!
+
+#ifdef USE_NNUE
+  Eval::NNUE::load();
+#endif
+  Threads.start_thinking(pos, states, l);
+  Threads.main()->wait_for_search_finished();
+  states = Threads.release_setup_states();
+
+  UCI::set_listeners(nullptr, nullptr);
+  TT.swap(tt);
+  Searching = nullptr;
+}
+
+
+/// Session::stop() stops the search of this session, if it is running
+
+void Session::stop() {
+
+  if (Searching == this)
+      Threads.stop = true;
+}
+
+
+/// Session::clear() clears the transposition table of the session, the search
+/// histories are shared with the other sessions and not cleared.
+
+void Session::clear() {
+
+  std::lock_guard<std::mutex> lk(SearchMutex);
+  tt.clear();
+}
+
+} // namespace Engine
@@ -0,0 +1,68 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINE_H_INCLUDED
+#define ENGINE_H_INCLUDED
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "position.h"
+#include "search.h"
+#include "tt.h"
+#include "uci.h"
+
+/// The Engine namespace is the entry point when the engine is linked as a
+/// library (make library) instead of being driven by UCI::loop() over stdin.
+
+namespace Engine {
+
+void init(int argc, char* argv[]);
+
+/// Session is a game or analysis played in-process. The sessions share the
+/// thread pool, the options and the NNUE network, each has its own position and
+/// transposition table. Only one session searches at a time, a concurrent go()
+/// waits for the running search to finish. A session owns its table and the
+/// search refers to it by address, so it can be neither copied nor moved.
+
+class Session {
+public:
+  typedef std::function<void(const UCI::PVInfo&)> InfoCallback;
+  typedef std::function<void(Move best, Move ponder)> BestMoveCallback;
+
+  explicit Session(size_t hashMB = 16);
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  void set_position(const std::string& fen, Variant v = CHESS_VARIANT,
+                    const std::vector<std::string>& moves = {}, bool chess960 = false);
+  void go(const Search::LimitsType& limits, InfoCallback onInfo, BestMoveCallback onBestMove);
+  void stop();
+  void clear();
+  const Position& position() const { return pos; }
+
+private:
+  TranspositionTable tt;
+  Position pos;
+  StateListPtr states;
+};
+
+} // namespace Engine
+
+#endif // #ifndef ENGINE_H_INCLUDED
@@ -17,7 +17,9 @@
 */
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>   // For std::memset
 #include <fstream>
@@ -56,6 +58,12 @@
 
 
 using namespace std;
+
+#ifdef BUGHOUSE
+int Eval::BughouseInflow[COLOR_NB][PIECE_TYPE_NB];
+Key Eval::BughouseInflowKey;
+#endif
+
 #ifdef USE_NNUE
 using namespace Eval::NNUE;
 
@@ -63,20 +71,54 @@ namespace Eval {
 
   bool useNNUE;
   string eval_file_loaded = "None";
+  HybridParams Hybrid[VARIANT_NB];
+  Key HybridKey;
+  bool LoadPending = true; // Set by NNUE::init(), the net is loaded by NNUE::load()
+
+  /// update_hybrid_key() is called when the net, its use or the thresholds of
+  /// the hybrid evaluation change, to set the key of their values.
+
+  void update_hybrid_key() {
+
+    HybridKey = make_key(useNNUE);
+    for (char c : eval_file_loaded)
+        HybridKey = make_key(HybridKey + uint8_t(c));
+    for (const HybridParams& hp : Hybrid)
+        HybridKey = make_key(HybridKey + (uint64_t(uint32_t(hp.threshold1)) << 32)
+                                       + (uint64_t(uint16_t(hp.threshold2)) << 16) + uint16_t(hp.strongClassical));
+  }
+
+  /// NNUE::init() is called when an option of the network is set. The network
+  /// is loaded later by NNUE::load(), so that the options sent before the first
+  /// "isready" or "go", such as SharedNNUE, all apply to the first load.
+
+  void NNUE::init() {
+
+    LoadPending = true;
+  }
 
-  /// NNUE::init() tries to load a NNUE network at startup time, or when the engine
-  /// receives a UCI command "setoption name EvalFile value nn-[a-z0-9]{12}.nnue"
+
+  /// NNUE::load() tries to load a NNUE network on "isready" or before the network
+  /// is used, if an option of the network was set since the last load, e.g. by a
+  /// UCI command "setoption name EvalFile value nn-[a-z0-9]{12}.nnue"
   /// The name of the NNUE network is always retrieved from the EvalFile option.
   /// We search the given network in three locations: internally (the default
   /// network may be embedded in the binary), in the active working directory and
   /// in the engine directory. Distro packagers may define the DEFAULT_NNUE_DIRECTORY
   /// variable to have the engine search in a special directory in their distro.
 
-  void NNUE::init() {
+  void NNUE::load() {
+
+    if (!LoadPending)
+        return;
 
+    LoadPending = false;
     useNNUE = Options["Use NNUE"];
     if (!useNNUE)
+    {
+        update_hybrid_key();
         return;
+    }
 
     string eval_file = string(Options["EvalFile"]);
 
@@ -113,6 +155,8 @@ namespace Eval {
                     eval_file_loaded = eval_file;
             }
         }
+
+    update_hybrid_key();
   }
 
   /// NNUE::verify() verifies that the last net used was loaded successfully
@@ -265,10 +309,6 @@ namespace {
     Value(11551),
 #endif
   };
-#ifdef USE_NNUE
-  constexpr Value NNUEThreshold1 =   Value(682);
-  constexpr Value NNUEThreshold2 =   Value(176);
-#endif
 
   // KingAttackWeights[PieceType] contains king attack weights by piece type
   constexpr int KingAttackWeights[VARIANT_NB][PIECE_TYPE_NB] = {
@@ -742,7 +782,7 @@ namespace {
 #undef S
 
   // Evaluation class computes and stores attacks tables and other working data
-  template<Tracing T>
+  template<Tracing T, Variant V>
   class Evaluation {
 
   public:
@@ -777,6 +817,9 @@ namespace {
     // color, including x-rays. But diagonal x-rays through pawns are not computed.
     Bitboard attackedBy2[COLOR_NB];
 
+    // The attack maps are not built by a lazy or hybrid evaluation
+    bool attacksBuilt = false;
+
     // kingRing[color] are the squares adjacent to the king plus some other
     // very near squares, depending on king position.
     Bitboard kingRing[COLOR_NB];
@@ -803,8 +846,8 @@ namespace {
   // Evaluation::initialize() computes king and pawn attacks, and the king ring
   // bitboard for a given color. This is done at the beginning of the evaluation.
 
-  template<Tracing T> template<Color Us>
-  void Evaluation<T>::initialize() {
+  template<Tracing T, Variant V> template<Color Us>
+  void Evaluation<T, V>::initialize() {
 
     constexpr Color     Them = ~Us;
     constexpr Direction Up   = pawn_push(Us);
@@ -812,7 +855,7 @@ namespace {
     constexpr Bitboard LowRanks = (Us == WHITE ? Rank2BB | Rank3BB : Rank7BB | Rank6BB);
 
 #ifdef HORDE
-    const Square ksq = (pos.is_horde() && pos.is_horde_color(Us)) ? SQ_NONE : pos.square<KING>(Us);
+    const Square ksq = (V == HORDE_VARIANT && pos.is_horde_color(Us)) ? SQ_NONE : pos.square<KING>(Us);
 #else
     const Square ksq = pos.square<KING>(Us);
 #endif
@@ -825,12 +868,12 @@ namespace {
     // Squares occupied by those pawns, by our king or queen, by blockers to attacks on our king
     // or controlled by enemy pawns are excluded from the mobility area.
 #ifdef ANTI
-    if (pos.is_anti())
+    if (V == ANTI_VARIANT)
         mobilityArea[Us] = ~b;
     else
 #endif
 #ifdef HORDE
-    if (pos.is_horde() && pos.is_horde_color(Us))
+    if (V == HORDE_VARIANT && pos.is_horde_color(Us))
         mobilityArea[Us] = ~(b | pe->pawn_attacks(Them));
     else
 #endif
@@ -838,11 +881,11 @@ namespace {
 
     // Initialize attackedBy[] for king and pawns
 #ifdef PLACEMENT
-    if (pos.is_placement() && pos.count_in_hand<KING>(Us))
+    if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && pos.count_in_hand<KING>(Us))
         attackedBy[Us][KING] = 0;
     else
 #endif
-    switch (pos.variant())
+    switch (V)
     {
 #ifdef ANTI
     case ANTI_VARIANT:
@@ -876,11 +919,11 @@ namespace {
 
     // Init our king safety tables
 #ifdef PLACEMENT
-    if (pos.is_placement() && pos.count_in_hand<KING>(Us))
+    if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && pos.count_in_hand<KING>(Us))
         kingRing[Us] = 0;
     else
 #endif
-    switch (pos.variant())
+    switch (V)
     {
 #ifdef ANTI
     case ANTI_VARIANT:
@@ -917,8 +960,8 @@ namespace {
 
   // Evaluation::pieces() scores pieces of a given color and type
 
-  template<Tracing T> template<Color Us, PieceType Pt>
-  Score Evaluation<T>::pieces() {
+  template<Tracing T, Variant V> template<Color Us, PieceType Pt>
+  Score Evaluation<T, V>::pieces() {
 
     constexpr Color     Them = ~Us;
     constexpr Direction Down = -pawn_push(Us);
@@ -939,7 +982,7 @@ namespace {
                          : attacks_bb<Pt>(s, pos.pieces());
 
 #ifdef GRID
-        if (pos.is_grid())
+        if (V == GRID_VARIANT)
             b &= ~pos.grid_bb(s);
 #endif
         if (pos.blockers_for_king(Us) & s)
@@ -952,7 +995,7 @@ namespace {
         if (b & kingRing[Them])
         {
             kingAttackersCount[Us]++;
-            kingAttackersWeight[Us] += KingAttackWeights[pos.variant()][Pt];
+            kingAttackersWeight[Us] += KingAttackWeights[V][Pt];
             kingAttacksCount[Us] += popcount(b & attackedBy[Them][KING]);
         }
 
@@ -964,22 +1007,22 @@ namespace {
 
         int mob = popcount(b & mobilityArea[Us]);
 #ifdef ANTI
-        if (pos.is_anti())
+        if (V == ANTI_VARIANT)
             continue;
 #endif
 #ifdef HORDE
-        if (pos.is_horde() && pos.is_horde_color(Us))
+        if (V == HORDE_VARIANT && pos.is_horde_color(Us))
             continue;
 #endif
 #ifdef PLACEMENT
-        if (pos.is_placement() && pos.count_in_hand<KING>(Us))
+        if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && pos.count_in_hand<KING>(Us))
             continue;
 #endif
 #ifdef LOSERS
-        if (pos.is_losers())
+        if (V == LOSERS_VARIANT)
             continue;
 #endif
-        mobility[Us] += MobilityBonus[pos.variant()][Pt - 2][mob];
+        mobility[Us] += MobilityBonus[V][Pt - 2][mob];
 
         if (Pt == BISHOP || Pt == KNIGHT)
         {
@@ -1082,23 +1125,23 @@ namespace {
 
   // Evaluation::king() assigns bonuses and penalties to a king of a given color
 
-  template<Tracing T> template<Color Us>
-  Score Evaluation<T>::king() const {
+  template<Tracing T, Variant V> template<Color Us>
+  Score Evaluation<T, V>::king() const {
 
 #ifdef ANTI
-    if (pos.is_anti())
+    if (V == ANTI_VARIANT)
         return SCORE_ZERO;
 #endif
 #ifdef EXTINCTION
-    if (pos.is_extinction())
+    if (V == EXTINCTION_VARIANT)
         return SCORE_ZERO;
 #endif
 #ifdef HORDE
-    if (pos.is_horde() && pos.is_horde_color(Us))
+    if (V == HORDE_VARIANT && pos.is_horde_color(Us))
         return SCORE_ZERO;
 #endif
 #ifdef PLACEMENT
-    if (pos.is_placement() && pos.count_in_hand<KING>(Us))
+    if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && pos.count_in_hand<KING>(Us))
         return SCORE_ZERO;
 #endif
 
@@ -1116,7 +1159,7 @@ namespace {
 
     // Attacked squares defended at most once by our queen or king
 #ifdef ATOMIC
-    if (pos.is_atomic())
+    if (V == ATOMIC_VARIANT)
         weak =  (attackedBy[Them][ALL_PIECES] ^ attackedBy[Them][KING])
               & ~(attackedBy[Us][ALL_PIECES] ^ attackedBy[Us][KING]);
     else
@@ -1127,14 +1170,14 @@ namespace {
 
     Bitboard h = 0;
 #ifdef CRAZYHOUSE
-    if (pos.is_house())
+    if (V == CRAZYHOUSE_VARIANT)
         h = pos.count_in_hand<QUEEN>(Them) ? weak & ~pos.pieces() : 0;
 #endif
 
     // Analyse the safe enemy's checks which are possible on next move
     safe  = ~pos.pieces(Them);
 #ifdef ATOMIC
-    if (pos.is_atomic())
+    if (V == ATOMIC_VARIANT)
         safe &= ~pos.pieces(Us) | attackedBy2[Them];
     else
 #endif
@@ -1148,7 +1191,7 @@ namespace {
 
     // Enemy rooks checks
 #ifdef CRAZYHOUSE
-    h = pos.is_house() && pos.count_in_hand<ROOK>(Them) ? ~pos.pieces() : 0;
+    h = (V == CRAZYHOUSE_VARIANT) && pos.count_in_hand<ROOK>(Them) ? ~pos.pieces() : 0;
 #endif
     rookChecks = b1 & (attackedBy[Them][ROOK] | (h & dropSafe)) & safe;
     if (rookChecks)
@@ -1159,7 +1202,7 @@ namespace {
     // Enemy queen safe checks: count them only if the checks are from squares from
     // which opponent cannot give a rook check, because rook checks are more valuable.
 #ifdef CRAZYHOUSE
-    h = pos.is_house() && pos.count_in_hand<QUEEN>(Them) ? ~pos.pieces() : 0;
+    h = (V == CRAZYHOUSE_VARIANT) && pos.count_in_hand<QUEEN>(Them) ? ~pos.pieces() : 0;
 #endif
     queenChecks =  (b1 | b2) & (attackedBy[Them][QUEEN] | (h & dropSafe)) & safe
                  & ~(attackedBy[Us][QUEEN] | rookChecks);
@@ -1169,7 +1212,7 @@ namespace {
     // Enemy bishops checks: count them only if they are from squares from which
     // opponent cannot give a queen check, because queen checks are more valuable.
 #ifdef CRAZYHOUSE
-    h = pos.is_house() && pos.count_in_hand<BISHOP>(Them) ? ~pos.pieces() : 0;
+    h = (V == CRAZYHOUSE_VARIANT) && pos.count_in_hand<BISHOP>(Them) ? ~pos.pieces() : 0;
 #endif
     bishopChecks =  b2 & (attackedBy[Them][BISHOP] | (h & dropSafe)) & safe
                   & ~queenChecks;
@@ -1181,7 +1224,7 @@ namespace {
 
     // Enemy knights checks
 #ifdef CRAZYHOUSE
-    h = pos.is_house() && pos.count_in_hand<KNIGHT>(Them) ? ~pos.pieces() : 0;
+    h = (V == CRAZYHOUSE_VARIANT) && pos.count_in_hand<KNIGHT>(Them) ? ~pos.pieces() : 0;
 #endif
     knightChecks = attacks_bb<KNIGHT>(ksq) & (attackedBy[Them][KNIGHT] | (h & dropSafe));
     if (knightChecks & safe)
@@ -1191,7 +1234,7 @@ namespace {
 
 #ifdef CRAZYHOUSE
     // Enemy pawn checks
-    if (pos.is_house())
+    if (V == CRAZYHOUSE_VARIANT)
     {
         constexpr Direction Down = pawn_push(Them);
         Bitboard pawnChecks = pawn_attacks_bb<Us>(ksq);
@@ -1204,7 +1247,7 @@ namespace {
     }
 #endif
 #ifdef RACE
-    if (pos.is_race())
+    if (V == RACE_VARIANT)
     {
         kingDanger = -kingDanger;
         int s = relative_rank(BLACK, ksq);
@@ -1229,7 +1272,7 @@ namespace {
     int kingFlankAttack  = popcount(b1) + popcount(b2);
     int kingFlankDefense = popcount(b3);
 
-    const auto KDP = KingDangerParams[pos.variant()];
+    const auto KDP = KingDangerParams[V];
     kingDanger +=        kingAttackersCount[Them] * kingAttackersWeight[Them] // (~10 Elo)
                  + KDP[0] * popcount(kingRing[Us] & weak)                     // (~15 Elo)
                  + KDP[1] * popcount(unsafeChecks)                            // (~4 Elo)
@@ -1243,7 +1286,7 @@ namespace {
                  + KDP[8] * kingFlankDefense                                     // (~5 Elo)
                  + KDP[9];                                                       // (~0.5 Elo)
 #ifdef CRAZYHOUSE
-    if (pos.is_house())
+    if (V == CRAZYHOUSE_VARIANT)
     {
         kingDanger += KingDangerInHand[ALL_PIECES] * pos.count_in_hand<ALL_PIECES>(Them);
         kingDanger += KingDangerInHand[PAWN] * pos.count_in_hand<PAWN>(Them);
@@ -1251,6 +1294,12 @@ namespace {
         kingDanger += KingDangerInHand[BISHOP] * pos.count_in_hand<BISHOP>(Them);
         kingDanger += KingDangerInHand[ROOK] * pos.count_in_hand<ROOK>(Them);
         kingDanger += KingDangerInHand[QUEEN] * pos.count_in_hand<QUEEN>(Them);
+#ifdef BUGHOUSE
+        // Pieces the opponent is expected to receive from the partner board
+        if (V == CRAZYHOUSE_VARIANT && pos.is_bughouse())
+            for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+                kingDanger += (KingDangerInHand[ALL_PIECES] + KingDangerInHand[pt]) * Eval::BughouseInflow[Them][pt] / 16;
+#endif
         h = pos.count_in_hand<QUEEN>(Them) ? weak & ~pos.pieces() : 0;
     }
 #endif
@@ -1260,9 +1309,9 @@ namespace {
     {
         int v = kingDanger * kingDanger / 4096;
 #ifdef CRAZYHOUSE
-        if (pos.is_house() && Us == pos.side_to_move())
+        if (V == CRAZYHOUSE_VARIANT && Us == pos.side_to_move())
             v -= v / 10;
-        if (pos.is_house())
+        if (V == CRAZYHOUSE_VARIANT)
             v = std::min(v, (int)QueenValueMg);
 #endif
         score -= make_score(v, kingDanger / 16 + KDP[10] * v / 256);
@@ -1273,7 +1322,7 @@ namespace {
         score -= PawnlessFlank;
 
     // Penalty if king flank is under attack, potentially moving toward the king
-    score -= FlankAttacks[pos.variant()] * kingFlankAttack;
+    score -= FlankAttacks[V] * kingFlankAttack;
 
     if constexpr (T)
         Trace::add(KING, Us, score);
@@ -1285,8 +1334,8 @@ namespace {
   // Evaluation::threats() assigns bonuses according to the types of the
   // attacking and the attacked pieces.
 
-  template<Tracing T> template<Color Us>
-  Score Evaluation<T>::threats() const {
+  template<Tracing T, Variant V> template<Color Us>
+  Score Evaluation<T, V>::threats() const {
 
     constexpr Color     Them     = ~Us;
     constexpr Direction Up       = pawn_push(Us);
@@ -1295,16 +1344,16 @@ namespace {
     Bitboard b, weak, defended, nonPawnEnemies, stronglyProtected, safe;
     Score score = SCORE_ZERO;
 #ifdef ANTI
-    if (pos.is_anti()) {} else
+    if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef ATOMIC
-    if (pos.is_atomic()) {} else
+    if (V == ATOMIC_VARIANT) {} else
 #endif
 #ifdef GRID
-    if (pos.is_grid()) {} else
+    if (V == GRID_VARIANT) {} else
 #endif
 #ifdef LOSERS
-    if (pos.is_losers()) {} else
+    if (V == LOSERS_VARIANT) {} else
 #endif
     {
     // Non-pawn enemies
@@ -1370,7 +1419,7 @@ namespace {
 
     // Bonus for threats on the next moves against enemy queen
 #ifdef CRAZYHOUSE
-    if ((pos.is_house() ? pos.count<QUEEN>(Them) - pos.count_in_hand<QUEEN>(Them) : pos.count<QUEEN>(Them)) == 1)
+    if ((V == CRAZYHOUSE_VARIANT ? pos.count<QUEEN>(Them) - pos.count_in_hand<QUEEN>(Them) : pos.count<QUEEN>(Them)) == 1)
 #else
     if (pos.count<QUEEN>(Them) == 1)
 #endif
@@ -1402,8 +1451,8 @@ namespace {
   // Evaluation::passed() evaluates the passed pawns and candidate passed
   // pawns of the given color.
 
-  template<Tracing T> template<Color Us>
-  Score Evaluation<T>::passed() const {
+  template<Tracing T, Variant V> template<Color Us>
+  Score Evaluation<T, V>::passed() const {
 
     constexpr Color     Them = ~Us;
     constexpr Direction Up   = pawn_push(Us);
@@ -1439,17 +1488,17 @@ namespace {
 
         int r = relative_rank(Us, s);
 
-        Score bonus = PassedRank[pos.variant()][r];
+        Score bonus = PassedRank[V][r];
 
 #ifdef GRID
-        if (pos.is_grid()) {} else
+        if (V == GRID_VARIANT) {} else
 #endif
         if (r > RANK_3)
         {
             int w = 5 * r - 13;
             Square blockSq = s + Up;
 #ifdef HORDE
-            if (pos.is_horde())
+            if (V == HORDE_VARIANT)
             {
                 // Assume a horde king distance of approximately 5
                 if (pos.is_horde_color(Us))
@@ -1460,15 +1509,15 @@ namespace {
             else
 #endif
 #ifdef PLACEMENT
-            if (pos.is_placement() && pos.count_in_hand<KING>(Us))
+            if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && pos.count_in_hand<KING>(Us))
                 bonus += make_score(0, 15 * w);
             else
 #endif
 #ifdef ANTI
-            if (pos.is_anti()) {} else
+            if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef ATOMIC
-            if (pos.is_atomic())
+            if (V == ATOMIC_VARIANT)
                 bonus += make_score(0, king_proximity(Them, blockSq) * 5 * w);
             else
 #endif
@@ -1526,11 +1575,11 @@ namespace {
   // on ranks 2 to 4. Completely safe squares behind a friendly pawn are counted twice.
   // Finally, the space bonus is multiplied by a weight which decreases according to occupancy.
 
-  template<Tracing T> template<Color Us>
-  Score Evaluation<T>::space() const {
+  template<Tracing T, Variant V> template<Color Us>
+  Score Evaluation<T, V>::space() const {
 
     // Early exit if, for example, both queens or 6 minor pieces have been exchanged
-    if (pos.non_pawn_material() < SpaceThreshold[pos.variant()])
+    if (pos.non_pawn_material() < SpaceThreshold[V])
         return SCORE_ZERO;
 
     constexpr Color Them     = ~Us;
@@ -1555,7 +1604,7 @@ namespace {
     int weight = pos.count<ALL_PIECES>(Us) - 3 + std::min(pe->blocked_count(), 9);
     Score score = make_score(bonus * weight * weight / 16, 0);
 #ifdef KOTH
-    if (pos.is_koth())
+    if (V == KOTH_VARIANT)
         score += KothSafeCenter * popcount(behind & safe & Center);
 #endif
 
@@ -1567,15 +1616,15 @@ namespace {
 
   // Evaluation::variant() computes variant-specific evaluation terms.
 
-  template<Tracing T> template<Color Us>
-  Score Evaluation<T>::variant() const {
+  template<Tracing T, Variant V> template<Color Us>
+  Score Evaluation<T, V>::variant() const {
 
     constexpr Color Them = (Us == WHITE ? BLACK : WHITE);
 
     Score score = SCORE_ZERO;
 
 #ifdef ANTI
-    if (pos.is_anti())
+    if (V == ANTI_VARIANT && attacksBuilt)
     {
         constexpr Bitboard TRank2BB = (Us == WHITE ? Rank2BB : Rank7BB);
         bool weCapture = attackedBy[Us][ALL_PIECES] & pos.pieces(Them);
@@ -1614,18 +1663,26 @@ namespace {
     }
 #endif
 #ifdef ATOMIC
-    if (pos.is_atomic())
+    if (V == ATOMIC_VARIANT)
     {
         // attackedBy may be undefined for lazy and hybrid evaluations
         // Rather than generating attackedBy (which would be complex and slow)
-        // use the same (non-queen) occupancy mask for all sliding attackers
+        // use the same (non-queen) occupancy mask for all sliding attackers.
+        // Our attacks are computed once, split between queens and the other
+        // pieces, instead of looking for the attackers of each enemy piece.
         Bitboard pieces = pos.pieces() ^ pos.pieces(QUEEN);
-        for (Bitboard b = pos.pieces(Them) & ~attacks_bb<KING>(pos.square<KING>(Us)); b; )
+        Bitboard attacked = pawn_attacks_bb<Us>(pos.pieces(Us, PAWN)), queenAttacked = 0;
+        for (Bitboard b = pos.pieces(Us) ^ pos.pieces(Us, PAWN); b; )
+        {
+            Square s = pop_lsb(&b);
+            PieceType pt = type_of(pos.piece_on(s));
+            (pt == QUEEN ? queenAttacked : attacked) |= attacks_bb(pt, s, pieces);
+        }
+        bool singleQueen = pos.count<QUEEN>(Us) == 1;
+
+        for (Bitboard b = pos.pieces(Them) & (attacked | queenAttacked) & ~attacks_bb<KING>(pos.square<KING>(Us)); b; )
         {
             Square s = pop_lsb(&b);
-            Bitboard attackers = pos.attackers_to(s, pieces) & pos.pieces(Us);
-            if (! attackers)
-                continue;
             Bitboard blast = (attacks_bb<KING>(s) & (pos.pieces() ^ pos.pieces(PAWN))) | s;
             int count = popcount(blast & pos.pieces(Them)) - popcount(blast & pos.pieces(Us)) - 1;
             if (blast & pos.pieces(Them, KING, QUEEN))
@@ -1636,7 +1693,7 @@ namespace {
             // multiple queens attack the same square, why should that matter?
             // Regardless, this is functionally equivalent and therefore cannot
             // cause a regression although attacker count is meaningless.
-            if ((blast & pos.pieces(Us, QUEEN)) || (attackers == pos.pieces(Us, QUEEN) && popcount(attackers) == 1))
+            if ((blast & pos.pieces(Us, QUEEN)) || (singleQueen && !(attacked & s)))
                 count--;
             score += std::max(SCORE_ZERO, ThreatByBlast * count);
         }
@@ -1644,16 +1701,20 @@ namespace {
     }
 #endif
 #ifdef HORDE
-    if (pos.is_horde() && pos.is_horde_color(Them))
+    if (V == HORDE_VARIANT && pos.is_horde_color(Them))
     {
         // Add a bonus according to how close we are to breaking through the pawn wall
         if (pos.pieces(Us, ROOK) | pos.pieces(Us, QUEEN))
         {
             int dist = 8;
             Bitboard target = (Us == WHITE ? Rank8BB : Rank1BB);
-            while (target)
+            for (Bitboard b = pos.pieces(Us, ROOK, QUEEN); b && dist; )
             {
-                if (pos.attackers_to(pop_lsb(&target)) & pos.pieces(Us, ROOK, QUEEN))
+                Square s = pop_lsb(&b);
+                Bitboard attacks = attacks_bb<ROOK>(s, pos.pieces());
+                if (type_of(pos.piece_on(s)) == QUEEN)
+                    attacks |= attacks_bb<BISHOP>(s, pos.pieces());
+                if (attacks & target)
                     dist = 0;
             }
             for (File f = FILE_A; f <= FILE_H; ++f)
@@ -1668,7 +1729,7 @@ namespace {
     }
 #endif
 #ifdef KOTH
-    if (pos.is_koth())
+    if (V == KOTH_VARIANT)
     {
         constexpr Direction Up = pawn_push(Us);
         Bitboard center = Center;
@@ -1685,7 +1746,7 @@ namespace {
     }
 #endif
 #ifdef LOSERS
-    if (pos.is_losers())
+    if (V == LOSERS_VARIANT && attacksBuilt)
     {
         constexpr Bitboard TRank2BB = (Us == WHITE ? Rank2BB : Rank7BB);
         constexpr Direction Up = pawn_push(Us);
@@ -1721,7 +1782,7 @@ namespace {
     }
 #endif
 #ifdef THREECHECK
-    if (pos.is_three_check())
+    if (V == THREECHECK_VARIANT)
         score += (popcount(pos.pieces(Us, BISHOP, KNIGHT) & WideCenter) * pos.checks_given(Us)) * pos.non_pawn_material(Us) / 16;
 #endif
 
@@ -1736,24 +1797,24 @@ namespace {
   // the known attacking/defending status of the players. The final value is derived
   // by interpolation from the midgame and endgame values.
 
-  template<Tracing T>
-  Value Evaluation<T>::winnable(Score score) const {
+  template<Tracing T, Variant V>
+  Value Evaluation<T, V>::winnable(Score score) const {
 
     bool pawnsOnBothFlanks =   (pos.pieces(PAWN) & QueenSide)
                             && (pos.pieces(PAWN) & KingSide);
 
     int complexity = 0;
 #ifdef ANTI
-    if (pos.is_anti()) {} else
+    if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef HORDE
-    if (pos.is_horde()) {} else
+    if (V == HORDE_VARIANT) {} else
 #endif
 #ifdef PLACEMENT
-    if (pos.is_placement() && (pos.count_in_hand<KING>(WHITE) || pos.count_in_hand<KING>(BLACK))) {} else
+    if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && (pos.count_in_hand<KING>(WHITE) || pos.count_in_hand<KING>(BLACK))) {} else
 #endif
 #ifdef LOSERS
-    if (pos.is_losers()) {} else
+    if (V == LOSERS_VARIANT) {} else
 #endif
     {
     int outflanking =  distance<File>(pos.square<KING>(WHITE), pos.square<KING>(BLACK))
@@ -1793,16 +1854,16 @@ namespace {
     int sf = me->scale_factor(pos, strongSide);
 
 #ifdef ANTI
-    if (pos.is_anti()) {} else
+    if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef EXTINCTION
-    if (pos.is_extinction()) {} else
+    if (V == EXTINCTION_VARIANT) {} else
 #endif
 #ifdef PLACEMENT
-    if (pos.is_placement() && pos.count_in_hand<KING>(~strongSide)) {} else
+    if (V == CRAZYHOUSE_VARIANT && pos.is_placement() && pos.count_in_hand<KING>(~strongSide)) {} else
 #endif
 #ifdef ATOMIC
-    if (pos.is_atomic())
+    if (V == ATOMIC_VARIANT)
     {
         if (   pos.non_pawn_material(~strongSide) <= RookValueMg
             && pos.count<PAWN>(WHITE) == pos.count<PAWN>(BLACK))
@@ -1811,7 +1872,7 @@ namespace {
     else
 #endif
 #ifdef HORDE
-    if (pos.is_horde() && pos.is_horde_color(~strongSide))
+    if (V == HORDE_VARIANT && pos.is_horde_color(~strongSide))
     {
         if (pos.non_pawn_material(~strongSide) >= QueenValueMg)
             sf = 10;
@@ -1875,8 +1936,8 @@ namespace {
   // parts of the evaluation and returns the value of the position from the point
   // of view of the side to move.
 
-  template<Tracing T>
-  Value Evaluation<T>::value() {
+  template<Tracing T, Variant V>
+  Value Evaluation<T, V>::value() {
 
     assert(!pos.checkers());
 
@@ -1887,9 +1948,14 @@ namespace {
     me = Material::probe(pos);
 
     // If we have a specialized evaluation function for the current material
-    // configuration, call it and return.
+    // configuration, call it and return, unless it needs a variant bitbase
+    // that is not ready yet.
     if (me->specialized_eval_exists())
-        return me->evaluate(pos);
+    {
+        Value v = me->evaluate(pos);
+        if (v != VALUE_NONE)
+            return v;
+    }
 
     // Initialize score by reading the incrementally updated scores included in
     // the position object (material + piece square tables) and the material
@@ -1905,7 +1971,7 @@ namespace {
         return abs(mg_value(score) + eg_value(score)) / 2 > lazyThreshold + pos.non_pawn_material() / 64;
     };
 
-    if (lazy_skip(LazyThreshold1[pos.variant()]))
+    if (lazy_skip(LazyThreshold1[V]))
         goto make_v;
 
     // Main evaluation begins here
@@ -1919,6 +1985,7 @@ namespace {
             + pieces<WHITE, ROOK  >() - pieces<BLACK, ROOK  >()
             + pieces<WHITE, QUEEN >() - pieces<BLACK, QUEEN >();
 
+    attacksBuilt = true;
     score += mobility[WHITE] - mobility[BLACK];
 
     // More complex interactions that require fully populated attack bitboards
@@ -1933,7 +2000,7 @@ namespace {
 
 make_v:
     // Derive single value from mg and eg parts of score
-    if (pos.variant() != CHESS_VARIANT)
+    if (V != CHESS_VARIANT)
         score += variant<WHITE>() - variant<BLACK>();
     Value v = winnable(score);
 
@@ -1955,11 +2022,15 @@ make_v:
     return v;
   }
 
-  template<Tracing T>
-  Value Evaluation<T>::variantValue(Value v) {
+  template<Tracing T, Variant V>
+  Value Evaluation<T, V>::variantValue(Value v) {
     me = Material::probe(pos);
     if (me->specialized_eval_exists())
-        return me->evaluate(pos);
+    {
+        Value v2 = me->evaluate(pos);
+        if (v2 != VALUE_NONE)
+            return v2;
+    }
 
     Score score = variant<WHITE>() - variant<BLACK>();
     Value mg = mg_value(score), eg = eg_value(score);
@@ -1971,6 +2042,102 @@ make_v:
     return v + (pos.side_to_move() == WHITE ? v2 : -v2);
   }
 
+
+  // The classical evaluation is instantiated for each variant, so that the
+  // variant tables are indexed at compile time and the terms of the other
+  // variants are compiled out. Eval::evaluate() then calls the instance of
+  // the position's variant through these tables.
+  typedef Value (ValueFn)(const Position&);
+  typedef Value (VariantValueFn)(const Position&, Value);
+
+  template<Tracing T, Variant V>
+  Value classical_value(const Position& pos) { return Evaluation<T, V>(pos).value(); }
+
+  template<Variant V>
+  Value variant_value(const Position& pos, Value v) { return Evaluation<NO_TRACE, V>(pos).variantValue(v); }
+
+  template<Tracing T, size_t... V>
+  constexpr std::array<ValueFn*, VARIANT_NB> classical_values(std::index_sequence<V...>) {
+    return {{ classical_value<T, Variant(V)>... }};
+  }
+
+  template<size_t... V>
+  constexpr std::array<VariantValueFn*, VARIANT_NB> variant_values(std::index_sequence<V...>) {
+    return {{ variant_value<Variant(V)>... }};
+  }
+
+  constexpr auto ClassicalValue = classical_values<NO_TRACE>(std::make_index_sequence<VARIANT_NB>());
+  constexpr auto ClassicalTrace = classical_values<TRACE>(std::make_index_sequence<VARIANT_NB>());
+  constexpr auto VariantValue   = variant_values(std::make_index_sequence<VARIANT_NB>());
+
+#ifdef USE_NNUE
+  // Scale and shift NNUE for compatibility with search and classical evaluation
+  Value adjusted_nnue(const Position& pos) {
+
+    int mat = pos.non_pawn_material() + 2 * PawnValueMg * pos.count<PAWN>();
+    Value v = Eval::NNUE::evaluate(pos) * (641 + mat / 32 - 4 * pos.rule50_count()) / 1024 + Tempo;
+
+    if (pos.variant() != CHESS_VARIANT)
+    {
+        pos.this_thread()->evalPaths[Eval::NNUE_VARIANT]++;
+        return VariantValue[pos.variant()](pos, v);
+    }
+
+    pos.this_thread()->evalPaths[Eval::NNUE_ONLY]++;
+    return v;
+  }
+#endif
+
+  // hybrid_value() returns the evaluation of the position, choosing between the
+  // classical and the NNUE evaluations with the thresholds of its variant.
+  Value hybrid_value(const Position& pos) {
+
+    Value v;
+
+#ifdef USE_NNUE
+    if (!Eval::useNNUE)
+#endif
+        v = ClassicalValue[pos.variant()](pos);
+#ifdef USE_NNUE
+    else
+    {
+        const Eval::HybridParams& hp = Eval::Hybrid[pos.variant()];
+        uint64_t* paths = pos.this_thread()->evalPaths;
+
+        // If there is PSQ imbalance use classical eval, with small probability if it is small
+        Value psq = Value(abs(eg_value(pos.psq_score())));
+        int   r50 = 16 + pos.rule50_count();
+        bool  largePsq = psq * 16 > (hp.threshold1 + pos.non_pawn_material() / 64) * r50;
+        bool  classical = largePsq || (psq > PawnValueMg / 4 && !(pos.this_thread()->nodes & 0xB));
+
+        // Use classical evaluation for really low piece endgames.
+        // The most critical case is a bishop + A/H file pawn vs naked king draw.
+        bool strongClassical = pos.non_pawn_material() < hp.strongClassical && pos.count<PAWN>() < 2;
+
+        v = classical || strongClassical ? ClassicalValue[pos.variant()](pos) : adjusted_nnue(pos);
+
+        // If the classical eval is small and imbalance large, use NNUE nevertheless.
+        // For the case of opposite colored bishops, switch to NNUE eval with
+        // small probability if the classical eval is less than the threshold.
+        if (   largePsq && !strongClassical
+            && (   abs(v) * 16 < hp.threshold2 * r50
+                || (   pos.opposite_bishops()
+                    && abs(v) * 16 < (hp.threshold1 + pos.non_pawn_material() / 64) * r50
+                    && !(pos.this_thread()->nodes & 0xB))))
+            v = adjusted_nnue(pos);
+
+        else if (classical || strongClassical)
+            paths[strongClassical ? Eval::CLASSICAL_STRONG : Eval::CLASSICAL_PSQ]++;
+    }
+#endif
+
+    // Damp down the evaluation linearly when shuffling
+    v = v * (100 - pos.rule50_count()) / 100;
+
+    // Guarantee evaluation does not hit the tablebase range
+    return std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+  }
+
 } // namespace
 
 
@@ -1979,57 +2146,90 @@ make_v:
 
 Value Eval::evaluate(const Position& pos) {
 
-  Value v;
+  Cache& cache = pos.this_thread()->evalCache;
+  Cache::Entry* e = nullptr;
+  Key key = 0;
 
-#ifdef USE_NNUE
-  if (!Eval::useNNUE)
+  if (cache.enabled())
+  {
+      key =  pos.key()
+           ^ make_key((uint64_t(uint32_t(pos.this_thread()->contempt)) << 16) + pos.rule50_count());
+#ifdef BUGHOUSE
+      key ^= BughouseInflowKey;
 #endif
-      v = Evaluation<NO_TRACE>(pos).value();
 #ifdef USE_NNUE
-  else
-  {
-      // Scale and shift NNUE for compatibility with search and classical evaluation
-      auto  adjusted_NNUE = [&](){
-         int mat = pos.non_pawn_material() + 2 * PawnValueMg * pos.count<PAWN>();
-         Value value = NNUE::evaluate(pos) * (641 + mat / 32 - 4 * pos.rule50_count()) / 1024 + Tempo;
-         if (pos.variant() != CHESS_VARIANT)
-             return Evaluation<NO_TRACE>(pos).variantValue(value);
-         return value;
-      };
-
-      // If there is PSQ imbalance use classical eval, with small probability if it is small
-      Value psq = Value(abs(eg_value(pos.psq_score())));
-      int   r50 = 16 + pos.rule50_count();
-      bool  largePsq = psq * 16 > (NNUEThreshold1 + pos.non_pawn_material() / 64) * r50;
-      bool  classical = largePsq || (psq > PawnValueMg / 4 && !(pos.this_thread()->nodes & 0xB));
-
-      // Use classical evaluation for really low piece endgames.
-      // The most critical case is a bishop + A/H file pawn vs naked king draw.
-      bool strongClassical = pos.non_pawn_material() < 2 * RookValueMg && pos.count<PAWN>() < 2;
-
-      v = classical || strongClassical ? Evaluation<NO_TRACE>(pos).value() : adjusted_NNUE();
-
-      // If the classical eval is small and imbalance large, use NNUE nevertheless.
-      // For the case of opposite colored bishops, switch to NNUE eval with
-      // small probability if the classical eval is less than the threshold.
-      if (   largePsq && !strongClassical
-          && (   abs(v) * 16 < NNUEThreshold2 * r50
-              || (   pos.opposite_bishops()
-                  && abs(v) * 16 < (NNUEThreshold1 + pos.non_pawn_material() / 64) * r50
-                  && !(pos.this_thread()->nodes & 0xB))))
-          v = adjusted_NNUE();
-  }
+      key ^= HybridKey;
 #endif
+      e = cache[key];
+      ++cache.probes;
+
+      if (e->key32 == uint32_t(key >> 32))
+      {
+          ++cache.hits;
+          return Value(e->value);
+      }
+  }
 
-  // Damp down the evaluation linearly when shuffling
-  v = v * (100 - pos.rule50_count()) / 100;
+  Value v = hybrid_value(pos);
 
-  // Guarantee evaluation does not hit the tablebase range
-  v = std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+  if (e)
+      e->key32 = uint32_t(key >> 32), e->value = v;
 
   return v;
 }
 
+
+#ifdef USE_NNUE
+
+/// Eval::hybrid_benchmark() times the evaluation of the position with the
+/// thresholds of its variant, in nanoseconds per call, and returns it with the
+/// error from the NNUE evaluation, taken as the reference. The evaluation paths
+/// are counted once.
+
+std::pair<double, Value> Eval::hybrid_benchmark(const Position& pos, int count) {
+
+  typedef std::chrono::steady_clock Clock;
+  uint64_t* paths = pos.this_thread()->evalPaths;
+  uint64_t saved[EVAL_PATH_NB] = {};
+  volatile Value sink;
+
+  std::copy(paths, paths + EVAL_PATH_NB, saved);
+
+  auto start = Clock::now();
+  for (int i = 0; i < count; ++i)
+      sink = hybrid_value(pos);
+  auto end = Clock::now();
+
+  (void)sink;
+
+  Value nnue = adjusted_nnue(pos) * (100 - pos.rule50_count()) / 100;
+  nnue = std::clamp(nnue, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+
+  std::copy(saved, saved + EVAL_PATH_NB, paths);
+
+  double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / count;
+  return { ns, Value(abs(hybrid_value(pos) - nnue)) };
+}
+
+#endif
+
+
+/// Cache::resize() sets the size of the evaluation cache, to the largest power
+/// of two number of entries that fits in the given MB, and clears it. A zero
+/// size disables the cache.
+
+void Eval::Cache::resize(size_t mbSize) {
+
+  size_t count = mbSize ? size_t(1) << msb(mbSize * 1024 * 1024 / sizeof(Entry)) : 0;
+
+  if (count != table.size())
+      table = std::vector<Entry>(count);
+  else
+      std::fill(table.begin(), table.end(), Entry());
+
+  probes = hits = 0;
+}
+
 /// trace() is like evaluate(), but instead of returning a value, it returns
 /// a string (suitable for outputting to stdout) that contains the detailed
 /// descriptions and values of each evaluation term. Useful for debugging.
@@ -2049,7 +2249,7 @@ std::string Eval::trace(const Position& pos) {
 
   pos.this_thread()->contempt = SCORE_ZERO; // Reset any dynamic contempt
 
-  v = Evaluation<TRACE>(pos).value();
+  v = ClassicalTrace[pos.variant()](pos);
 
   ss << std::showpoint << std::noshowpos << std::fixed << std::setprecision(2)
      << "     Term    |    White    |    Black    |    Total   \n"
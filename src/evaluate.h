@@ -19,7 +19,10 @@
 #ifndef EVALUATE_H_INCLUDED
 #define EVALUATE_H_INCLUDED
 
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "types.h"
 
@@ -30,10 +33,54 @@ namespace Eval {
   std::string trace(const Position& pos);
   Value evaluate(const Position& pos);
 
+  /// Cache is a per thread table of the static evaluations, indexed by the
+  /// position key mixed with the other inputs of the evaluation, that is the
+  /// 50-move counter, the thread's contempt and the NNUE settings, so that a
+  /// hit returns the same value as computing it again.
+  struct Cache {
+
+    struct Entry {
+      uint32_t key32;
+      int32_t value;
+    };
+
+    void resize(size_t mbSize);
+    Entry* operator[](Key key) { return &table[size_t(key) & (table.size() - 1)]; }
+    bool enabled() const { return !table.empty(); }
+
+    uint64_t probes, hits;
+
+  private:
+    std::vector<Entry> table;
+  };
+
+#ifdef BUGHOUSE
+  // Pieces expected to be passed by the partner board to each side during the
+  // search, by piece type, in 1/16th of a piece
+  extern int BughouseInflow[COLOR_NB][PIECE_TYPE_NB];
+  extern Key BughouseInflowKey; // Part of the evaluation cache key
+#endif
+
+  // Paths taken by Eval::evaluate(), counted by each thread
+  enum EvalPath { CLASSICAL_PSQ, CLASSICAL_STRONG, NNUE_ONLY, NNUE_VARIANT, EVAL_PATH_NB };
+
 #ifdef USE_NNUE
   extern bool useNNUE;
   extern std::string eval_file_loaded;
 
+  // Thresholds of the choice between the classical and the NNUE evaluations:
+  // the PSQ imbalance above which the classical evaluation is used, the
+  // classical evaluation below which NNUE is used nevertheless, and the non
+  // pawn material below which the classical evaluation is always used.
+  struct HybridParams {
+    int threshold1 = 682, threshold2 = 176, strongClassical = 2 * RookValueMg;
+  };
+
+  extern HybridParams Hybrid[VARIANT_NB]; // By variant
+  extern Key HybridKey; // Part of the evaluation cache key
+  void update_hybrid_key();
+  std::pair<double, Value> hybrid_benchmark(const Position& pos, int count);
+
   // The default net name MUST follow the format nn-[SHA256 first 12 digits].nnue
   // for the build process (profile-build and fishtest) to work. Do not change the
   // name of the macro, as it is used in the Makefile.
@@ -42,8 +89,10 @@ namespace Eval {
   namespace NNUE {
 
     Value evaluate(const Position& pos);
+    std::pair<double, double> benchmark(const Position& pos, int count);
     bool load_eval(std::string name, std::istream& stream);
     void init();
+    void load();
     void verify();
 
   } // namespace NNUE
@@ -18,36 +18,20 @@
 
 #include <iostream>
 
-#include "bitboard.h"
-#include "endgame.h"
-#include "position.h"
-#include "psqt.h"
-#include "search.h"
-#include "syzygy/tbprobe.h"
+#include "engine.h"
+#include "misc.h"
 #include "thread.h"
-#include "tt.h"
 #include "uci.h"
 
 int main(int argc, char* argv[]) {
 
   std::cout << engine_info() << std::endl;
 
-  CommandLine::init(argc, argv);
-  UCI::init(Options);
-  Tune::init();
-  PSQT::init();
-  Bitboards::init();
-  Position::init();
-  Bitbases::init();
-  Endgames::init();
-  Threads.set(size_t(Options["Threads"]));
-  Search::clear(); // After threads are up
-#ifdef USE_NNUE
-  Eval::NNUE::init();
-#endif
+  Engine::init(argc, argv);
 
   UCI::loop(argc, argv);
 
   Threads.set(0);
+  UCI::wait_for_output();
   return 0;
 }
@@ -466,10 +466,16 @@ namespace Material {
 Entry* probe(const Position& pos) {
 
   Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+  Thread* th = pos.this_thread();
+  Entry* e = th->materialTable[key];
+
+  ++th->materialProbes;
 
   if (e->key == key)
+  {
+      ++th->materialHits;
       return e;
+  }
 
   std::memset(e, 0, sizeof(Entry));
   e->key = key;
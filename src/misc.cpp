@@ -43,12 +43,17 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <cstdlib>
 
 #if defined(__linux__) && !defined(__ANDROID__)
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) || (defined(__GLIBCXX__) && !defined(_GLIBCXX_HAVE_ALIGNED_ALLOC) && !defined(_WIN32))
@@ -467,6 +472,147 @@ void aligned_large_pages_free(void *mem) {
 #endif
 
 
+/// shared_memory_attach() maps the named memory segment shared by all the processes
+/// of the host, creating it with the given size if it does not exist yet. Only the
+/// process that creates the segment, as reported by 'created', maps it writable,
+/// and it holds an exclusive lock on it until it calls shared_memory_share(). The
+/// system releases the lock if the process dies, so that a segment left unfilled
+/// can be told from one being filled. The 'handle' holds the lock of the process
+/// until shared_memory_detach() is called.
+
+void* shared_memory_attach(const std::string& name, size_t size, bool& created, int& handle) {
+
+  created = false;
+  handle = -1;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  int fd = -1;
+
+  for (int attempt = 0; attempt < 2 && fd == -1; ++attempt)
+  {
+      fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+      created = fd != -1;
+
+      if (created)
+      {
+          if (flock(fd, LOCK_EX) == -1 || ftruncate(fd, off_t(size)) == -1)
+          {
+              close(fd);
+              shm_unlink(name.c_str());
+              return nullptr;
+          }
+          break;
+      }
+
+      fd = shm_open(name.c_str(), O_RDONLY, 0);
+      if (fd == -1)
+          return nullptr;
+
+      // The process creating the segment may have not yet set its size. If it
+      // has not after a while and does not hold its lock anymore, it died before:
+      // remove the segment and try to create it again.
+      struct stat st {};
+      for (int i = 0; fstat(fd, &st) == -1 || size_t(st.st_size) != size; ++i)
+      {
+          if (i == 1000 || (st.st_size && size_t(st.st_size) != size))
+          {
+              bool stale = !st.st_size && flock(fd, LOCK_SH | LOCK_NB) == 0;
+              if (stale)
+                  shared_memory_remove(name, fd);
+
+              close(fd);
+              fd = -1;
+              if (!stale)
+                  return nullptr;
+              break;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+  }
+
+  if (fd == -1)
+      return nullptr;
+
+  void* mem = mmap(nullptr, size, created ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+  if (mem == MAP_FAILED)
+  {
+      if (created)
+          shm_unlink(name.c_str());
+      close(fd);
+      return nullptr;
+  }
+
+#if defined(MADV_HUGEPAGE)
+  madvise(mem, size, MADV_HUGEPAGE);
+#endif
+  handle = fd;
+  return mem;
+#else
+  (void)name; (void)size;
+  return nullptr;
+#endif
+}
+
+
+/// shared_memory_share() takes a shared lock on the segment, which turns the
+/// exclusive lock of the creating process into a shared one. It returns false,
+/// unless 'wait' is set, if the creating process still holds its exclusive lock.
+
+bool shared_memory_share(int handle, bool wait) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  return handle != -1 && flock(handle, wait ? LOCK_SH : LOCK_SH | LOCK_NB) == 0;
+#else
+  (void)handle; (void)wait;
+  return false;
+#endif
+}
+
+
+/// shared_memory_detach() unmaps the segment, and removes it when no other process
+/// holds a lock on it, so that it does not outlive the last process using it.
+
+void shared_memory_detach(const std::string& name, void* mem, size_t size, int handle) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (mem)
+      munmap(mem, size);
+
+  if (handle != -1)
+  {
+      if (flock(handle, LOCK_EX | LOCK_NB) == 0)
+          shared_memory_remove(name, handle);
+      close(handle);
+  }
+#else
+  (void)name; (void)mem; (void)size; (void)handle;
+#endif
+}
+
+
+/// shared_memory_remove() removes the named segment, unless the name has been
+/// given in the meantime to a new segment, other than the one of the handle.
+
+void shared_memory_remove(const std::string& name, int handle) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1)
+      return;
+
+  struct stat st1 {}, st2 {};
+  if (   fstat(fd, &st1) == 0 && fstat(handle, &st2) == 0
+      && st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino)
+      shm_unlink(name.c_str());
+
+  close(fd);
+#else
+  (void)name; (void)handle;
+#endif
+}
+
+
 namespace WinProcGroup {
 
 #ifndef _WIN32
@@ -629,3 +775,83 @@ void init(int argc, char* argv[]) {
 
 
 } // namespace CommandLine
+
+namespace Startup {
+
+namespace {
+
+  typedef std::chrono::steady_clock Clock;
+
+  const Clock::time_point ProcessStart = Clock::now();
+
+  struct StageTime {
+    string name;
+    int64_t start, elapsed; // In microseconds since process start
+  };
+
+  std::vector<StageTime> stageTimes;
+  std::mutex stageMutex;
+
+  int64_t micros(Clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - ProcessStart).count();
+  }
+
+} // namespace
+
+/// run() executes the given stages, each one on its own thread with the last
+/// one on the calling thread, and returns once all of them are done.
+
+void run(const std::vector<Stage>& stages) {
+
+  auto timed = [](const Stage& stage) {
+      auto start = Clock::now();
+      stage.second();
+      auto end = Clock::now();
+
+      std::lock_guard<std::mutex> lk(stageMutex);
+      stageTimes.push_back({ stage.first, micros(start), micros(end) - micros(start) });
+  };
+
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i + 1 < stages.size(); ++i)
+      threads.emplace_back(timed, std::cref(stages[i]));
+
+  if (!stages.empty())
+      timed(stages.back());
+
+  for (std::thread& th : threads)
+      th.join();
+}
+
+
+/// profile() returns a table with the start time and duration of each stage
+
+string profile() {
+
+  std::lock_guard<std::mutex> lk(stageMutex);
+  std::vector<StageTime> times = stageTimes;
+  std::stringstream ss;
+  int64_t total = 0;
+
+  std::stable_sort(times.begin(), times.end(), [](const StageTime& a, const StageTime& b) {
+      return a.start < b.start;
+  });
+
+  ss << std::left << std::setw(20) << "Stage"
+     << std::right << std::setw(12) << "Start (us)" << std::setw(12) << "Time (us)";
+
+  for (const StageTime& t : times)
+  {
+      ss << "\n" << std::left << std::setw(20) << t.name
+         << std::right << std::setw(12) << t.start << std::setw(12) << t.elapsed;
+      total = std::max(total, t.start + t.elapsed);
+  }
+
+  ss << "\n" << std::left << std::setw(20) << "Total"
+     << std::right << std::setw(12) << 0 << std::setw(12) << total;
+
+  return ss.str();
+}
+
+} // namespace Startup
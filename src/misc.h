@@ -21,6 +21,7 @@
 
 #include <cassert>
 #include <chrono>
+#include <functional>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -36,6 +37,10 @@ void* std_aligned_alloc(size_t alignment, size_t size);
 void std_aligned_free(void* ptr);
 void* aligned_large_pages_alloc(size_t size); // memory aligned by page size, min alignment: 4096 bytes
 void aligned_large_pages_free(void* mem); // nop if mem == nullptr
+void* shared_memory_attach(const std::string& name, size_t size, bool& created, int& handle); // nullptr if unsupported
+bool shared_memory_share(int handle, bool wait);
+void shared_memory_detach(const std::string& name, void* mem, size_t size, int handle);
+void shared_memory_remove(const std::string& name, int handle);
 
 void dbg_hit_on(bool b);
 void dbg_hit_on(bool c, bool b);
@@ -139,8 +144,20 @@ namespace WinProcGroup {
 namespace CommandLine {
   void init(int argc, char* argv[]);
 
+  extern std::string argv0;            // path+name of the executable binary
   extern std::string binaryDirectory;  // path of the executable directory
   extern std::string workingDirectory; // path of the working directory
 }
 
+/// Startup runs the initialization stages of the engine, those without mutual
+/// dependencies on parallel threads, and keeps the time spent in each of them
+/// to be reported by the 'startup-profile' command.
+
+namespace Startup {
+  typedef std::pair<std::string, std::function<void()>> Stage;
+
+  void run(const std::vector<Stage>& stages);
+  std::string profile();
+}
+
 #endif // #ifndef MISC_H_INCLUDED
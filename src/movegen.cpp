@@ -386,10 +386,6 @@ namespace {
             target = ~pos.pieces(Us);
             break;
     }
-#ifdef ANTI
-    if (V == ANTI_VARIANT && pos.can_capture())
-        target &= pos.pieces(~Us);
-#endif
 #ifdef ATOMIC
     if (V == ATOMIC_VARIANT)
     {
@@ -439,8 +435,6 @@ namespace {
 #ifdef ANTI
     case ANTI_VARIANT:
         moveList = generate_king_moves<V, Us, Type>(pos, moveList, target);
-        if (pos.can_capture())
-            return moveList;
     break;
 #endif
 #ifdef EXTINCTION
@@ -534,6 +528,12 @@ ExtMove* generate(const Position& pos, ExtMove* moveList) {
   {
 #ifdef ANTI
   case ANTI_VARIANT:
+      // Captures are compulsory, so test once whether any capture exists and
+      // then generate either the captures only or the unrestricted move list.
+      if (Type != CAPTURES && pos.can_capture())
+          return Type == QUIETS ? moveList
+               : us == WHITE    ? generate_all<ANTI_VARIANT, WHITE, CAPTURES>(pos, moveList)
+                                : generate_all<ANTI_VARIANT, BLACK, CAPTURES>(pos, moveList);
       return us == WHITE ? generate_all<ANTI_VARIANT, WHITE, Type>(pos, moveList)
                          : generate_all<ANTI_VARIANT, BLACK, Type>(pos, moveList);
 #endif
@@ -61,6 +61,11 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const ButterflyHist
 
   assert(d > 0);
 
+#ifdef ANTI
+  // When captures are compulsory only the capture stages can produce moves
+  forcedCaptures = pos.is_anti() && pos.can_capture();
+#endif
+
   stage = (pos.checkers() ? EVASION_TT : MAIN_TT) +
           !(ttm && pos.pseudo_legal(ttm));
 }
@@ -194,6 +199,17 @@ top:
                               true : (*endBadCaptures++ = *cur, false); }))
           return *(cur - 1);
 
+#ifdef ANTI
+      // Refutations and quiets are all illegal, go straight to the bad captures
+      if (forcedCaptures)
+      {
+          cur = moves;
+          endMoves = endBadCaptures;
+          stage = BAD_CAPTURE;
+          goto top;
+      }
+#endif
+
       // Prepare the pointers to loop over the refutations array
       cur = std::begin(refutations);
       endMoves = std::end(refutations);
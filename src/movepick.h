@@ -153,6 +153,9 @@ private:
   Value threshold;
   Depth depth;
   int ply;
+#ifdef ANTI
+  bool forcedCaptures;
+#endif
   ExtMove moves[MAX_MOVES];
 };
 
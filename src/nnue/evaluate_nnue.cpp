@@ -18,8 +18,12 @@
 
 // Code for calculating NNUE evaluation function
 
+#include <atomic>
 #include <iostream>
+#include <iterator>
 #include <set>
+#include <sstream>
+#include <thread>
 
 #include "../evaluate.h"
 #include "../position.h"
@@ -37,6 +41,31 @@ namespace Eval::NNUE {
   // Evaluation function
   AlignedPtr<Network> network;
 
+  // Parameters mapped from a memory segment shared by all the engine processes
+  // of the host, see load_shared()
+  struct SharedParameters {
+    std::atomic<std::uint32_t> state;
+    FeatureTransformer transformer;
+    Network network;
+  };
+
+  enum SharedState : std::uint32_t { kFilling, kReady, kFailed };
+
+  struct SharedDeleter {
+    std::string name;
+    int handle = -1;
+
+    void operator()(SharedParameters* ptr) const {
+      shared_memory_detach(name, ptr, sizeof(SharedParameters), handle);
+    }
+  };
+
+  std::unique_ptr<SharedParameters, SharedDeleter> shared_parameters;
+
+  // Parameters used by the evaluation, either private or shared ones
+  const FeatureTransformer* transformer;
+  const Network* evaluator;
+
   // Evaluation function file name
   std::string fileName;
 
@@ -92,17 +121,108 @@ namespace Eval::NNUE {
   }
 
   // Read network parameters
-  bool ReadParameters(std::istream& stream) {
+  bool ReadParameters(std::istream& stream, FeatureTransformer& ft, Network& net) {
 
     std::uint32_t hash_value;
     std::string architecture;
     if (!ReadHeader(stream, &hash_value, &architecture)) return false;
     if (hash_value != kHashValue) return false;
-    if (!Detail::ReadParameters(stream, *feature_transformer)) return false;
-    if (!Detail::ReadParameters(stream, *network)) return false;
+    if (!Detail::ReadParameters(stream, ft)) return false;
+    if (!Detail::ReadParameters(stream, net)) return false;
     return stream && stream.peek() == std::ios::traits_type::eof();
   }
 
+  // Name of the shared segment for the given network file. Besides the content
+  // of the file, the in-memory layout of the parameters depends on the build.
+  std::string SharedName(const std::string& content) {
+
+    std::uint64_t h = 14695981039346656037ULL; // FNV-1a
+    auto mix = [&](std::uint64_t v) { h = (h ^ v) * 1099511628211ULL; };
+
+    for (char c : content)
+        mix(std::uint8_t(c));
+
+    mix(kHashValue);
+    mix(sizeof(SharedParameters));
+    mix(  1 * Is64Bit
+#if defined(USE_SSSE3)
+        | 2
+#endif
+#if defined(USE_VNNI)
+        | 4
+#endif
+       );
+
+    std::stringstream ss;
+    ss << "/stockfish-nnue-" << std::hex << h;
+    return ss.str();
+  }
+
+  // Map the parameters from a segment shared by all the engine processes of the
+  // host. The first process reads them into the segment, the others wait for it
+  // and map the segment read-only, so that parsing and memory are paid only once.
+  bool load_shared(std::istream& stream) {
+
+    // C++ way to prepare a buffer for a memory stream
+    class MemoryBuffer : public std::basic_streambuf<char> {
+        public: MemoryBuffer(char* p, size_t n) { setg(p, p, p + n); setp(p, p + n); }
+    };
+
+    std::string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    MemoryBuffer buffer(&content[0], content.size());
+    std::istream memoryStream(&buffer);
+
+    std::string name = SharedName(content);
+
+    // A segment left unfilled by a process that died is removed and created
+    // again, once.
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        bool created;
+        int handle;
+        void* mem = shared_memory_attach(name, sizeof(SharedParameters), created, handle);
+
+        if (!mem)
+            break;
+
+        shared_parameters = std::unique_ptr<SharedParameters, SharedDeleter>(
+            static_cast<SharedParameters*>(mem), SharedDeleter{ name, handle });
+
+        if (created)
+        {
+            bool ok = ReadParameters(memoryStream, shared_parameters->transformer, shared_parameters->network);
+            shared_parameters->state.store(ok ? kReady : kFailed, std::memory_order_release);
+            shared_memory_share(handle, true);
+            if (!ok)
+                shared_parameters.reset();
+            return ok;
+        }
+
+        // Wait for the creating process to fill the segment, until it releases
+        // its exclusive lock. If it does so without filling it, it died.
+        bool locked = false;
+        for (int i = 0; i < 10000 && !(locked = shared_memory_share(handle, false)); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::uint32_t state = shared_parameters->state.load(std::memory_order_acquire);
+        if (locked && state == kReady)
+            return true;
+
+        bool stale = locked && state == kFilling;
+        if (stale)
+            shared_memory_remove(name, handle);
+
+        shared_parameters.reset();
+        if (!stale)
+            break;
+    }
+
+    // Shared memory is not available, or the segment was not filled in time:
+    // read private parameters instead
+    Initialize();
+    return ReadParameters(memoryStream, *feature_transformer, *network);
+  }
+
   // Evaluation function. Perform differential calculation.
   Value evaluate(const Position& pos) {
 
@@ -127,18 +247,59 @@ namespace Eval::NNUE {
     ASSERT_ALIGNED(transformed_features, alignment);
     ASSERT_ALIGNED(buffer, alignment);
 
-    feature_transformer->Transform(pos, transformed_features);
-    const auto output = network->Propagate(transformed_features, buffer);
+    transformer->Transform(pos, transformed_features);
+    const auto output = evaluator->Propagate(transformed_features, buffer);
 
     return static_cast<Value>(output[0] / FV_SCALE);
   }
 
+  // Time the evaluation of the given position, in nanoseconds per call, both with
+  // the accumulator refreshed from scratch and with the accumulator up to date.
+  std::pair<double, double> benchmark(const Position& pos, int count) {
+
+    typedef std::chrono::steady_clock Clock;
+    auto& accumulator = pos.state()->accumulator;
+    volatile Value sink;
+
+    auto start = Clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        accumulator.state[WHITE] = accumulator.state[BLACK] = INIT;
+        sink = evaluate(pos);
+    }
+    auto refreshed = Clock::now();
+    for (int i = 0; i < count; ++i)
+        sink = evaluate(pos);
+    auto updated = Clock::now();
+
+    (void)sink;
+
+    auto ns = [count](Clock::duration d) {
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) / count;
+    };
+    return { ns(refreshed - start), ns(updated - refreshed) };
+  }
+
   // Load eval, from a file stream or a memory stream
   bool load_eval(std::string name, std::istream& stream) {
 
-    Initialize();
+    shared_parameters.reset();
+    feature_transformer.reset();
+    network.reset();
     fileName = name;
-    return ReadParameters(stream);
+
+    bool ok;
+    if (Options["SharedNNUE"])
+        ok = load_shared(stream);
+    else
+    {
+        Initialize();
+        ok = ReadParameters(stream, *feature_transformer, *network);
+    }
+
+    transformer = shared_parameters ? &shared_parameters->transformer : feature_transformer.get();
+    evaluator   = shared_parameters ? &shared_parameters->network     : network.get();
+    return ok;
   }
 
 } // namespace Eval::NNUE
@@ -246,23 +246,26 @@ namespace Eval::NNUE::Layers {
 #if defined (USE_AVX512)
       using vec_t = __m512i;
       #define vec_setzero _mm512_setzero_si512
+      #define vec_add_32 _mm512_add_epi32
       #define vec_set_32 _mm512_set1_epi32
       auto& vec_add_dpbusd_32 = m512_add_dpbusd_epi32;
-      auto& vec_add_dpbusd_32x4 = m512_add_dpbusd_epi32x4;
+      [[maybe_unused]] auto& vec_add_dpbusd_32x4 = m512_add_dpbusd_epi32x4;
       auto& vec_hadd = m512_hadd;
 #elif defined (USE_AVX2)
       using vec_t = __m256i;
       #define vec_setzero _mm256_setzero_si256
+      #define vec_add_32 _mm256_add_epi32
       #define vec_set_32 _mm256_set1_epi32
       auto& vec_add_dpbusd_32 = m256_add_dpbusd_epi32;
-      auto& vec_add_dpbusd_32x4 = m256_add_dpbusd_epi32x4;
+      [[maybe_unused]] auto& vec_add_dpbusd_32x4 = m256_add_dpbusd_epi32x4;
       auto& vec_hadd = m256_hadd;
 #elif defined (USE_SSSE3)
       using vec_t = __m128i;
       #define vec_setzero _mm_setzero_si128
+      #define vec_add_32 _mm_add_epi32
       #define vec_set_32 _mm_set1_epi32
       auto& vec_add_dpbusd_32 = m128_add_dpbusd_epi32;
-      auto& vec_add_dpbusd_32x4 = m128_add_dpbusd_epi32x4;
+      [[maybe_unused]] auto& vec_add_dpbusd_32x4 = m128_add_dpbusd_epi32x4;
       auto& vec_hadd = m128_hadd;
 #endif
 
@@ -278,10 +281,25 @@ namespace Eval::NNUE::Layers {
       if constexpr (kOutputDimensions % kOutputSimdWidth == 0)
       {
           constexpr IndexType kNumChunks = kPaddedInputDimensions / 4;
+          constexpr IndexType kNumRegs = kOutputDimensions / kOutputSimdWidth;
 
           const auto input32 = reinterpret_cast<const std::int32_t*>(input);
+          const auto biasvec = reinterpret_cast<const vec_t*>(biases_);
           vec_t* outptr = reinterpret_cast<vec_t*>(output);
-          std::memcpy(output, biases_, kOutputDimensions * sizeof(OutputType));
+
+          // Keep the sums in registers instead of going through the output buffer,
+          // which the compiler must assume to alias the input.
+          vec_t acc[kNumRegs];
+          for (IndexType k = 0; k < kNumRegs; ++k)
+              acc[k] = biasvec[k];
+
+#if defined (USE_VNNI)
+          // With VNNI each product is accumulated in 32 bits, so we can split the
+          // dependency chain of the dot products over two sets of accumulators.
+          vec_t acc2[kNumRegs];
+          for (IndexType k = 0; k < kNumRegs; ++k)
+              acc2[k] = vec_setzero();
+#endif
 
           for (int i = 0; i < (int)kNumChunks - 3; i += 4)
           {
@@ -293,9 +311,26 @@ namespace Eval::NNUE::Layers {
               const auto col1 = reinterpret_cast<const vec_t*>(&weights_[(i + 1) * kOutputDimensions * 4]);
               const auto col2 = reinterpret_cast<const vec_t*>(&weights_[(i + 2) * kOutputDimensions * 4]);
               const auto col3 = reinterpret_cast<const vec_t*>(&weights_[(i + 3) * kOutputDimensions * 4]);
-              for (int j = 0; j * kOutputSimdWidth < kOutputDimensions; ++j)
-                  vec_add_dpbusd_32x4(outptr[j], in0, col0[j], in1, col1[j], in2, col2[j], in3, col3[j]);
+              for (IndexType j = 0; j < kNumRegs; ++j)
+              {
+#if defined (USE_VNNI)
+                  vec_add_dpbusd_32(acc[j], in0, col0[j]);
+                  vec_add_dpbusd_32(acc2[j], in1, col1[j]);
+                  vec_add_dpbusd_32(acc[j], in2, col2[j]);
+                  vec_add_dpbusd_32(acc2[j], in3, col3[j]);
+#else
+                  vec_add_dpbusd_32x4(acc[j], in0, col0[j], in1, col1[j], in2, col2[j], in3, col3[j]);
+#endif
+              }
           }
+
+          for (IndexType k = 0; k < kNumRegs; ++k)
+#if defined (USE_VNNI)
+              outptr[k] = vec_add_32(acc[k], acc2[k]);
+#else
+              outptr[k] = acc[k];
+#endif
+
           for (int i = 0; i < canSaturate16.count; ++i)
               output[canSaturate16.ids[i].out] += input[canSaturate16.ids[i].in] * canSaturate16.ids[i].w;
       }
@@ -259,6 +259,127 @@ namespace {
   #undef S
   #undef V
 
+#ifdef HORDE
+  // fill() extends each bit of a bitboard along its file towards direction D,
+  // which is either NORTH or SOUTH. The original bits are kept.
+  template<Direction D>
+  constexpr Bitboard fill(Bitboard b) {
+    static_assert(D == NORTH || D == SOUTH, "Files are filled vertically");
+    b |= D == NORTH ? b <<  8 : b >>  8;
+    b |= D == NORTH ? b << 16 : b >> 16;
+    b |= D == NORTH ? b << 32 : b >> 32;
+    return b;
+  }
+
+
+  /// evaluate_horde() scores the pawns of the side playing the horde. With up
+  /// to 36 pawns the per pawn loop of evaluate() is too slow, so the pawn flags
+  /// are computed for all pawns at once with shifts and file fills, and most
+  /// terms are scored with popcounts. Only the connected bonus, which depends
+  /// on the rank, and the passed pawn test, which is done for the frontmost
+  /// pawn of each file, still loop over pawns. The score is the same as the
+  /// one of the generic loop.
+
+  template<Color Us>
+  Score evaluate_horde(const Position& pos, Pawns::Entry* e) {
+
+    constexpr Color     Them     = ~Us;
+    constexpr Direction Up       = pawn_push(Us);
+    constexpr Direction Down     = -Up;
+    constexpr Direction UpEast   = (Us == WHITE ? NORTH_EAST : SOUTH_EAST);
+    constexpr Direction UpWest   = (Us == WHITE ? NORTH_WEST : SOUTH_WEST);
+    constexpr Bitboard  TRank5BB = (Us == WHITE ? Rank5BB : Rank4BB);
+    constexpr Bitboard  TRank6BB = (Us == WHITE ? Rank6BB : Rank3BB);
+
+    Score score = SCORE_ZERO;
+
+    Bitboard ourPawns   = pos.pieces(  Us, PAWN);
+    Bitboard theirPawns = pos.pieces(Them, PAWN);
+
+    Bitboard doubleAttackThem = pawn_double_attacks_bb<Them>(theirPawns);
+    Bitboard ourFiles   = fill<NORTH>(fill<SOUTH>(ourPawns));
+    Bitboard theirFiles = fill<NORTH>(fill<SOUTH>(theirPawns));
+    Bitboard ourRear    = fill<Up>(ourPawns);
+
+    // Flag all the pawns. Pawns on the first rank have no pawn behind them,
+    // so they are neither doubled nor supported.
+    Bitboard opposed    = ourPawns & fill<Down>(shift<Down>(theirPawns));
+    Bitboard blocked    = ourPawns & shift<Down>(theirPawns);
+    Bitboard leverPush  = ourPawns & shift<Down>(pawn_attacks_bb<Them>(theirPawns));
+    Bitboard weakLever  = ourPawns & doubleAttackThem;
+    Bitboard doubled    = ourPawns & shift<Up>(ourPawns);
+    Bitboard neighbours = ourPawns & (shift<EAST>(ourFiles) | shift<WEST>(ourFiles));
+    Bitboard phalanx    = ourPawns & (shift<EAST>(ourPawns) | shift<WEST>(ourPawns));
+    Bitboard supportE   = ourPawns & shift<UpEast>(ourPawns);
+    Bitboard supportW   = ourPawns & shift<UpWest>(ourPawns);
+    Bitboard backward   =  ourPawns & ~(shift<EAST>(ourRear) | shift<WEST>(ourRear))
+                         & (leverPush | blocked);
+
+    Bitboard b = ourPawns & ~backward & ~blocked;
+    e->pawnAttacksSpan[Us] |= fill<Up>(pawn_attacks_bb<Us>(b));
+
+    // Passed pawns, among the frontmost pawn of each file
+    b = ourPawns & ~fill<Down>(shift<Down>(ourPawns));
+    while (b)
+    {
+        Square s = pop_lsb(&b);
+        Bitboard stoppers = theirPawns & passed_pawn_span(Us, s);
+        Bitboard lever    = theirPawns & pawn_attacks_bb(Us, s);
+        Bitboard push     = theirPawns & pawn_attacks_bb(Us, s + Up);
+        Bitboard support  = ourPawns & pawn_attacks_bb(Them, s);
+        Bitboard phalanxS = ourPawns & adjacent_files_bb(s) & rank_bb(s);
+
+        if (   !(stoppers ^ lever)
+            || (   !(stoppers ^ push)
+                && popcount(phalanxS) >= popcount(push))
+            || (   stoppers == (theirPawns & (s + Up))
+                && relative_rank(Us, s) >= RANK_5
+                && (shift<Up>(support) & ~(theirPawns | doubleAttackThem))))
+            e->passedPawns[Us] |= s;
+    }
+
+    // Connected pawns
+    b = supportE | supportW | phalanx;
+    Bitboard unconnected = ourPawns & ~b;
+    while (b)
+    {
+        Square s = pop_lsb(&b);
+        Rank r = relative_rank(Us, s);
+        int v =  Connected[r] * (2 + bool(phalanx & s) - bool(opposed & s))
+               + 22 * (bool(supportE & s) + bool(supportW & s));
+
+        score += make_score(v, v * (r - 2) / 4);
+    }
+
+    // Isolated pawns, doubled when behind one of our pawns and opposed by an
+    // enemy pawn that has no pawn on the adjacent files
+    Bitboard isolated = unconnected & ~neighbours;
+    b = isolated & opposed & fill<Up>(shift<Up>(ourPawns))
+                 & ~(shift<EAST>(theirFiles) | shift<WEST>(theirFiles));
+    isolated &= ~b;
+
+    score -=  Doubled[HORDE_VARIANT] * popcount(b)
+            + Isolated[HORDE_VARIANT] * popcount(isolated)
+            + WeakUnopposed * popcount(isolated & ~opposed);
+
+    // Backward pawns
+    backward &= unconnected & neighbours;
+    score -=  Backward[HORDE_VARIANT] * popcount(backward)
+            + WeakUnopposed * popcount(backward & ~opposed & ~(FileABB | FileHBB));
+
+    if (doubled && !(ourPawns & shift<Down>(theirPawns | pawn_attacks_bb<Them>(theirPawns))))
+        score -= DoubledEarly * popcount(doubled);
+
+    score -=  Doubled[HORDE_VARIANT] * popcount(doubled)
+            + WeakLever * popcount(weakLever);
+
+    score +=  BlockedPawn[0] * popcount(blocked & TRank5BB)
+            + BlockedPawn[1] * popcount(blocked & TRank6BB);
+
+    return score;
+  }
+#endif
+
 
   /// evaluate() calculates a score for the static pawn structure of the given position.
   /// We cannot use the location of pieces or king in this function, as the evaluation
@@ -298,6 +419,8 @@ namespace {
             l = m; m = r; r = popcount(ourPawns & shift<EAST>(file_bb(f1)));
             score -= ImbalancedHorde * m / (1 + l * r);
         }
+
+        return score + evaluate_horde<Us>(pos, e);
     }
 #endif
     // Loop through all pawns of the current color and score each pawn
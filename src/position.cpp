@@ -580,6 +580,7 @@ void Position::set_state(StateInfo* si) const {
   si->key = si->materialKey = Zobrist::variant[var];
   si->pawnKey = Zobrist::noPawns;
   si->nonPawnMaterial[WHITE] = si->nonPawnMaterial[BLACK] = VALUE_ZERO;
+  si->psq = SCORE_ZERO;
 
   set_check_info(si);
 #ifdef HORDE
@@ -614,6 +615,7 @@ void Position::set_state(StateInfo* si) const {
       Square s = pop_lsb(&b);
       Piece pc = piece_on(s);
       si->key ^= Zobrist::psq[pc][s];
+      si->psq += PSQT::psq[var][pc][s];
 
       if (type_of(pc) == PAWN)
           si->pawnKey ^= Zobrist::psq[pc][s];
@@ -641,7 +643,11 @@ void Position::set_state(StateInfo* si) const {
           if (type_of(pc) != PAWN && type_of(pc) != KING)
               si->nonPawnMaterial[color_of(pc)] += pieceCountInHand[color_of(pc)][type_of(pc)] * PieceValue[CHESS_VARIANT][MG][pc];
           for (int cnt = 0; cnt < pieceCountInHand[color_of(pc)][type_of(pc)]; ++cnt)
+          {
               si->key ^= Zobrist::inHand[pc][cnt];
+              si->materialKey ^= Zobrist::inHand[pc][cnt];
+          }
+          si->psq += PSQT::psq[CRAZYHOUSE_VARIANT][pc][SQ_NONE] * pieceCountInHand[color_of(pc)][type_of(pc)];
       }
 #endif
   }
@@ -1572,6 +1578,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
       // Update board and piece lists
       remove_piece(capsq);
+      st->psq -= PSQT::psq[var][captured][capsq];
 #ifdef CRAZYHOUSE
       if (is_house())
       {
@@ -1585,7 +1592,9 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           {
               Piece add = is_promoted(capsq) ? make_piece(~color_of(captured), PAWN) : ~captured;
               add_to_hand(color_of(add), type_of(add));
+              st->psq += PSQT::psq[CRAZYHOUSE_VARIANT][add][SQ_NONE];
               k ^= Zobrist::inHand[add][pieceCountInHand[color_of(add)][type_of(add)] - 1];
+              st->materialKey ^= Zobrist::inHand[add][pieceCountInHand[color_of(add)][type_of(add)] - 1];
           }
           promotedPieces -= capsq;
       }
@@ -1612,6 +1621,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
                   // Update board and piece lists
                   remove_piece(bsq);
+                  st->psq -= PSQT::psq[var][bpc][bsq];
 
                   // Update material hash key
                   k ^= Zobrist::psq[bpc][bsq];
@@ -1690,7 +1700,9 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   if (is_house() && type_of(m) == DROP)
   {
       drop_piece(pc, to);
-      st->materialKey ^= Zobrist::psq[pc][pieceCount[pc]-1];
+      st->psq += PSQT::psq[var][pc][to] - PSQT::psq[CRAZYHOUSE_VARIANT][pc][SQ_NONE];
+      st->materialKey ^=  Zobrist::psq[pc][pieceCount[pc]-1]
+                        ^ Zobrist::inHand[pc][pieceCountInHand[us][type_of(pc)]];
 #ifdef PLACEMENT
       if (is_placement() && !count_in_hand<ALL_PIECES>(us))
       {
@@ -1724,6 +1736,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       if (is_atomic() && captured) // Remove the blast piece(s)
       {
           remove_piece(from);
+          st->psq -= PSQT::psq[var][pc][from];
           // Update material (hash key already updated)
           st->materialKey ^= Zobrist::psq[pc][pieceCount[pc]];
           if (type_of(pc) != PAWN)
@@ -1731,7 +1744,10 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       }
       else
 #endif
-      move_piece(from, to);
+      {
+          move_piece(from, to);
+          st->psq += PSQT::psq[var][pc][to] - PSQT::psq[var][pc][from];
+      }
   }
 
   // If the moving piece is a pawn do some special extra work
@@ -1776,6 +1792,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
           remove_piece(to);
           put_piece(promotion, to);
+          st->psq += PSQT::psq[var][promotion][to] - PSQT::psq[var][pc][to];
 #ifdef CRAZYHOUSE
 #ifdef LOOP
           if (is_house() && !is_loop())
@@ -2074,6 +2091,10 @@ void Position::do_castling(Color us, Square from, Square& to, Square& rfrom, Squ
   board[Do ? from : to] = board[Do ? rfrom : rto] = NO_PIECE; // Since remove_piece doesn't do this for us
   put_piece(make_piece(us, KING), Do ? to : from);
   put_piece(make_piece(us, ROOK), Do ? rto : rfrom);
+
+  if (Do)
+      st->psq +=  PSQT::psq[var][make_piece(us, KING)][to] - PSQT::psq[var][make_piece(us, KING)][from]
+                + PSQT::psq[var][make_piece(us, ROOK)][rto] - PSQT::psq[var][make_piece(us, ROOK)][rfrom];
 }
 
 
@@ -2395,6 +2416,77 @@ bool Position::see_ge(Move m, Value threshold) const {
 }
 
 
+#if defined(KOTH) || defined(THREECHECK)
+/// Position::can_win_in_one() tests whether the side to move has a legal move
+/// that reaches the goal of the variant: a king move to the center in King of
+/// the Hill, or the third check in Three-check. The check squares and the
+/// blockers of the enemy king rule out most positions without generating the
+/// moves.
+
+bool Position::can_win_in_one() const {
+
+  Color us = sideToMove;
+
+  switch (var)
+  {
+#ifdef KOTH
+  case KOTH_VARIANT:
+  {
+      Square ksq = square<KING>(us);
+      Bitboard b = attacks_bb<KING>(ksq) & Center & ~pieces(us);
+
+      while (b)
+          if (!(attackers_to(pop_lsb(&b), pieces() ^ ksq) & pieces(~us)))
+              return true;
+      return false;
+  }
+#endif
+#ifdef THREECHECK
+  case THREECHECK_VARIANT:
+  {
+      if (st->checksGiven[us] != CHECKS_2)
+          return false;
+
+      // Direct checks by pieces are tried one by one, unless we are in check
+      // and the evasions have to be generated anyway.
+      if (!checkers())
+          for (Bitboard b = pieces(us) ^ pieces(us, PAWN, KING); b; )
+          {
+              Square s = pop_lsb(&b);
+              PieceType pt = type_of(piece_on(s));
+              Bitboard checks = attacks_bb(pt, s, pieces()) & check_squares(pt) & ~pieces(us);
+
+              while (checks)
+                  if (legal(make_move(s, pop_lsb(&checks))))
+                      return true;
+          }
+
+      // Other checks are rarer, look for them in the legal moves when a pawn,
+      // a discovered check, castling or en passant may give one.
+      Bitboard pawns = pieces(us, PAWN);
+      Bitboard pawnTargets = us == WHITE ? shift<NORTH>(pawns | shift<NORTH>(pawns & Rank2BB)) | pawn_attacks_bb<WHITE>(pawns)
+                                         : shift<SOUTH>(pawns | shift<SOUTH>(pawns & Rank7BB)) | pawn_attacks_bb<BLACK>(pawns);
+
+      if (    checkers()
+          || (blockers_for_king(~us) & pieces(us))
+          ||  can_castle(us & ANY_CASTLING)
+          ||  ep_square() != SQ_NONE
+          || (pawns & rank_bb(relative_rank(us, RANK_7)))
+          || (pawnTargets & check_squares(PAWN)))
+          for (const auto& m : MoveList<LEGAL>(*this))
+              if (gives_check(m))
+                  return true;
+
+      return false;
+  }
+#endif
+  default:
+      return false;
+  }
+}
+#endif
+
+
 /// Position::is_draw() tests whether the position is drawn by 50-move rule
 /// or by repetition. It does not detect stalemates.
 
@@ -2487,6 +2579,36 @@ bool Position::has_game_cycle(int ply) const {
 }
 
 
+#ifdef BUGHOUSE
+/// Position::set_holdings() sets the pieces in hand of both sides, given with
+/// the FEN piece letters, or adds them to the hands if 'add' is true. It lets
+/// the partner board pass pieces between searches without setting up again
+/// the position, so the history of StateInfo is kept.
+
+void Position::set_holdings(const string& holdings, bool add) {
+
+  if (!add)
+      for (Color c : { WHITE, BLACK })
+          for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+              while (pieceCountInHand[c][pt])
+                  remove_from_hand(c, pt);
+
+  size_t idx;
+  for (char token : holdings)
+      if (isalpha(token) && (idx = PieceToChar.find(token)) != string::npos)
+      {
+          Piece pc = Piece(idx);
+          if (type_of(pc) != KING && pieceCountInHand[color_of(pc)][type_of(pc)] < 15)
+              add_to_hand(color_of(pc), type_of(pc));
+      }
+
+  set_state(st);
+
+  assert(pos_is_ok());
+}
+#endif
+
+
 /// Position::flip() flips position with the white and black sides reversed. This
 /// is only useful for debugging e.g. for finding evaluation symmetry bugs.
 
@@ -44,6 +44,7 @@ struct StateInfo {
   Key    pawnKey;
   Key    materialKey;
   Value  nonPawnMaterial[COLOR_NB];
+  Score  psq;
   int    castlingRights;
   int    rule50;
   int    pliesFromNull;
@@ -197,6 +198,9 @@ public:
   Value variant_result(int ply = 0, Value draw_value = VALUE_DRAW) const;
   Value checkmate_value(int ply = 0) const;
   Value stalemate_value(int ply = 0, Value draw_value = VALUE_DRAW) const;
+#if defined(KOTH) || defined(THREECHECK)
+  bool can_win_in_one() const;
+#endif
 #ifdef ATOMIC
   bool is_atomic() const;
   bool is_atomic_win() const;
@@ -219,6 +223,8 @@ public:
 #endif
 #ifdef BUGHOUSE
   bool is_bughouse() const;
+  void set_holdings(const std::string& holdings, bool add);
+  int count_in_hand(Color c, PieceType pt) const;
 #endif
 #ifdef LOOP
   bool is_loop() const;
@@ -346,7 +352,6 @@ private:
   Bitboard castlingPath[CASTLING_RIGHT_NB];
   int gamePly;
   Color sideToMove;
-  Score psq;
   Thread* thisThread;
   StateInfo* st;
   bool chess960;
@@ -623,7 +628,7 @@ inline Key Position::material_key() const {
 }
 
 inline Score Position::psq_score() const {
-  return psq;
+  return st->psq;
 }
 
 inline Value Position::non_pawn_material(Color c) const {
@@ -890,13 +895,11 @@ template<PieceType Pt> inline int Position::count_in_hand() const {
 inline void Position::add_to_hand(Color c, PieceType pt) {
   pieceCountInHand[c][pt]++;
   pieceCountInHand[c][ALL_PIECES]++;
-  psq += PSQT::psq[CRAZYHOUSE_VARIANT][make_piece(c, pt)][SQ_NONE];
 }
 
 inline void Position::remove_from_hand(Color c, PieceType pt) {
   pieceCountInHand[c][pt]--;
   pieceCountInHand[c][ALL_PIECES]--;
-  psq -= PSQT::psq[CRAZYHOUSE_VARIANT][make_piece(c, pt)][SQ_NONE];
 }
 
 inline bool Position::is_promoted(Square s) const {
@@ -908,6 +911,10 @@ inline bool Position::is_promoted(Square s) const {
 inline bool Position::is_bughouse() const {
   return var == CRAZYHOUSE_VARIANT && subvar == BUGHOUSE_VARIANT;
 }
+
+inline int Position::count_in_hand(Color c, PieceType pt) const {
+  return pieceCountInHand[c][pt];
+}
 #endif
 
 #ifdef LOOP
@@ -1194,7 +1201,6 @@ inline void Position::put_piece(Piece pc, Square s) {
   byColorBB[color_of(pc)] |= s;
   pieceCount[pc]++;
   pieceCount[make_piece(color_of(pc), ALL_PIECES)]++;
-  psq += PSQT::psq[var][pc][s];
 }
 
 inline void Position::remove_piece(Square s) {
@@ -1210,7 +1216,6 @@ inline void Position::remove_piece(Square s) {
   /* board[s] = NO_PIECE;  Not needed, overwritten by the capturing one */
   pieceCount[pc]--;
   pieceCount[make_piece(color_of(pc), ALL_PIECES)]--;
-  psq -= PSQT::psq[var][pc][s];
 }
 
 inline void Position::move_piece(Square from, Square to) {
@@ -1222,7 +1227,6 @@ inline void Position::move_piece(Square from, Square to) {
   byColorBB[color_of(pc)] ^= fromTo;
   board[from] = NO_PIECE;
   board[to] = pc;
-  psq += PSQT::psq[var][pc][to] - PSQT::psq[var][pc][from];
 }
 
 #ifdef CRAZYHOUSE
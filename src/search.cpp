@@ -23,12 +23,14 @@
 #include <iostream>
 #include <sstream>
 
+#include "book.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
 #include "position.h"
 #include "search.h"
+#include "solve.h"
 #include "thread.h"
 #include "timeman.h"
 #include "tt.h"
@@ -335,8 +337,15 @@ void MainThread::search() {
       return;
   }
 
+  if (Limits.solve)
+  {
+      Solver::solve(rootPos);
+      return;
+  }
+
   Color us = rootPos.side_to_move();
-  Time.init(rootPos.variant(), Limits, us, rootPos.game_ply());
+  bool bookHit = false;
+  Time.init(rootPos, Limits, us, rootPos.game_ply());
   TT.new_search();
 
 #ifdef USE_NNUE
@@ -353,8 +362,21 @@ void MainThread::search() {
   }
   else
   {
-      Threads.start_searching(); // start non-main threads
-      Thread::search();          // main thread start searching
+      Move bookMove = MOVE_NONE;
+
+      if (Options["OwnBook"] && !Limits.infinite && !Limits.mate)
+          bookMove = Book::probe(rootPos, Options["BestBookMove"]);
+
+      if (bookMove && std::count(rootMoves.begin(), rootMoves.end(), bookMove))
+      {
+          std::swap(rootMoves[0], *std::find(rootMoves.begin(), rootMoves.end(), bookMove));
+          bookHit = true;
+      }
+      else
+      {
+          Threads.start_searching(); // start non-main threads
+          Thread::search();          // main thread start searching
+      }
   }
 
   // When we reach the maximum depth, we can arrive here without a raise of
@@ -381,6 +403,7 @@ void MainThread::search() {
   Thread* bestThread = this;
 
   if (   int(Options["MultiPV"]) == 1
+      && !bookHit
       && !Limits.depth
       && !(Skill(Options["Skill Level"]).enabled() || int(Options["UCI_LimitStrength"]))
       && rootMoves[0].pv[0] != MOVE_NONE)
@@ -390,15 +413,14 @@ void MainThread::search() {
 
   // Send again PV info if we have a new best thread
   if (bestThread != this)
-      sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
-
-  // Best move could be MOVE_NONE when searching on a terminal position
-  sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
+      UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE);
 
+  Move ponderMove = MOVE_NONE;
   if (bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos))
-      std::cout << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
+      ponderMove = bestThread->rootMoves[0].pv[1];
 
-  std::cout << sync_endl;
+  // Best move could be MOVE_NONE when searching on a terminal position
+  UCI::send_bestmove(bestThread->rootMoves[0].pv[0], ponderMove, rootPos.is_chess960());
 }
 
 
@@ -445,6 +467,7 @@ void Thread::search() {
   std::fill(&lowPlyHistory[MAX_LPH - 2][0], &lowPlyHistory.back().back() + 1, 0);
 
   size_t multiPV = size_t(Options["MultiPV"]);
+  bool jointMultiPV = Options["Joint MultiPV"];
 
   // Pick integer skill levels, but non-deterministically round up or down
   // such that the average integer skill corresponds to the input floating point one.
@@ -501,7 +524,9 @@ void Thread::search() {
       if (!Threads.increaseDepth)
          searchAgainCounter++;
 
-      // MultiPV loop. We perform a full root search for each PV line
+      // MultiPV loop. We perform a full root search for each PV line, or with
+      // "Joint MultiPV" a single root search for all the lines of the same
+      // tablebase rank, keeping alpha at the score of the last line found.
       for (pvIdx = 0; pvIdx < multiPV && !Threads.stop; ++pvIdx)
       {
           if (pvIdx == pvLast)
@@ -512,6 +537,8 @@ void Thread::search() {
                       break;
           }
 
+          pvWidth = jointMultiPV ? std::min(multiPV, pvLast) - pvIdx : 1;
+
           // Reset UCI info selDepth for each depth and each PV line
           selDepth = 0;
 
@@ -523,6 +550,10 @@ void Thread::search() {
               alpha = std::max(prev - delta,-VALUE_INFINITE);
               beta  = std::min(prev + delta, VALUE_INFINITE);
 
+              // The window of the joint search spans all of its lines
+              if (pvWidth > 1)
+                  alpha = std::max(rootMoves[pvIdx + pvWidth - 1].previousScore - delta, -VALUE_INFINITE);
+
               // Adjust contempt based on root move's previousScore (dynamic contempt)
               int dct = ct + (113 - ct / 2) * prev / (abs(prev) + 147);
 
@@ -537,6 +568,12 @@ void Thread::search() {
           while (true)
           {
               Depth adjustedDepth = std::max(1, rootDepth - failedHighCnt - searchAgainCounter);
+
+              // Lines not reached by the joint search keep their previous score
+              if (pvWidth > 1)
+                  for (size_t i = pvIdx; i < pvLast; ++i)
+                      rootMoves[i].score = -VALUE_INFINITE;
+
               bestValue = ::search<PV>(rootPos, ss, alpha, beta, adjustedDepth, false);
 #ifdef HELPMATE
               if (rootPos.is_helpmate()) bestValue = -bestValue;
@@ -562,11 +599,23 @@ void Thread::search() {
                   && multiPV == 1
                   && (bestValue <= alpha || bestValue >= beta)
                   && Time.elapsed() > PV_MIN_ELAPSED)
-                  sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+                  UCI::pv(rootPos, rootDepth, alpha, beta);
 
               // In case of failing low/high increase aspiration window and
-              // re-search, otherwise exit the loop.
-              if (bestValue <= alpha)
+              // re-search, otherwise exit the loop. The joint search fails low
+              // when less than pvWidth moves score above alpha.
+              if (pvWidth > 1 && bestValue < beta)
+              {
+                  if (rootMoves[pvIdx + pvWidth - 1].score != -VALUE_INFINITE)
+                      break;
+
+                  alpha = std::max(alpha - delta, -VALUE_INFINITE);
+
+                  failedHighCnt = 0;
+                  if (mainThread)
+                      mainThread->stopOnPonderhit = false;
+              }
+              else if (bestValue <= alpha)
               {
                   beta = (alpha + beta) / 2;
                   alpha = std::max(bestValue - delta, -VALUE_INFINITE);
@@ -592,11 +641,12 @@ void Thread::search() {
 #endif
 
           // Sort the PV lines searched so far and update the GUI
+          pvIdx += pvWidth - 1;
           std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
           if (    mainThread
               && (Threads.stop || pvIdx + 1 == multiPV || Time.elapsed() > PV_MIN_ELAPSED))
-              sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+              UCI::pv(rootPos, rootDepth, alpha, beta);
       }
 
       if (!Threads.stop)
@@ -760,6 +810,12 @@ namespace {
             return (ss->ply >= MAX_PLY && !ss->inCheck) ? evaluate(pos)
                                                         : value_draw(pos.this_thread());
 
+#if defined(KOTH) || defined(THREECHECK)
+        // A king move to the center, or a third check, wins at once
+        if (pos.can_win_in_one())
+            return mate_in(ss->ply + 1);
+#endif
+
         // Step 3. Mate distance pruning. Even if we mate at the next move our score
         // would be at best mate_in(ss->ply+1), but if alpha is already bigger because
         // a shorter mate was found upward in the tree then there is no need to search
@@ -1195,9 +1251,18 @@ moves_loop: // When in check, search starts from here
     // Mark this node as being searched
     ThreadHolding th(thisThread, posKey, ss->ply);
 
+    // A joint MultiPV search visits the root moves in the order of the previous
+    // iteration, so that the lines are found first and alpha is raised early.
+    size_t rootIdx = rootNode && thisThread->pvWidth > 1 ? thisThread->pvIdx : thisThread->pvLast;
+    auto next_move = [&]() {
+        return rootIdx < thisThread->pvLast ? thisThread->rootMoves[rootIdx++].pv[0]
+                                            : rootNode && thisThread->pvWidth > 1 ? MOVE_NONE
+                                                                                  : mp.next_move(moveCountPruning);
+    };
+
     // Step 11. Loop through all pseudo-legal moves until no moves remain
     // or a beta cutoff occurs.
-    while ((move = mp.next_move(moveCountPruning)) != MOVE_NONE)
+    while ((move = next_move()) != MOVE_NONE)
     {
       assert(is_ok(move));
 
@@ -1555,8 +1620,9 @@ moves_loop: // When in check, search starts from here
           RootMove& rm = *std::find(thisThread->rootMoves.begin(),
                                     thisThread->rootMoves.end(), move);
 
-          // PV move or new best move?
-          if (moveCount == 1 || value > alpha)
+          // PV move or new best move? In a joint MultiPV search a first move
+          // failing low is only an upper bound, as for the other moves.
+          if ((moveCount == 1 && thisThread->pvWidth == 1) || value > alpha)
           {
               rm.score = value;
               rm.selDepth = thisThread->selDepth;
@@ -1569,8 +1635,24 @@ moves_loop: // When in check, search starts from here
 
               // We record how often the best move has been changed in each
               // iteration. This information is used for time management and LMR
-              if (moveCount > 1)
+              if (moveCount > 1 && (thisThread->pvWidth == 1 || value > bestValue))
                   ++thisThread->bestMoveChanges;
+
+              // In a joint MultiPV search alpha is the score of the last line
+              if (thisThread->pvWidth > 1)
+              {
+                  std::vector<Value> scores;
+                  for (size_t i = thisThread->pvIdx; i < thisThread->pvLast; ++i)
+                      if (thisThread->rootMoves[i].score != -VALUE_INFINITE)
+                          scores.push_back(thisThread->rootMoves[i].score);
+
+                  if (scores.size() >= thisThread->pvWidth)
+                  {
+                      auto nth = scores.begin() + thisThread->pvWidth - 1;
+                      std::nth_element(scores.begin(), nth, scores.end(), std::greater<Value>());
+                      alpha = std::max(alpha, *nth);
+                  }
+              }
           }
           else
               // All other moves but the PV are set to the lowest value: this
@@ -1591,7 +1673,7 @@ moves_loop: // When in check, search starts from here
                   update_pv(ss->pv, move, (ss+1)->pv);
 
               if (PvNode && value < beta) // Update alpha! Always alpha < beta
-                  alpha = value;
+                  alpha = rootNode && thisThread->pvWidth > 1 ? alpha : value;
               else
               {
                   assert(value >= beta); // Fail high
@@ -1740,7 +1822,7 @@ moves_loop: // When in check, search starts from here
         // When infinite looping in quiescent search give some update
         // (without cluttering the UI)
         if (Threads.nodes_searched() % (PV_MIN_ELAPSED * 4) == 0)
-            sync_cout << UCI::pv(pos, ttDepth, alpha, beta) << sync_endl;
+            UCI::pv(pos, ttDepth, alpha, beta);
         return ttValue;
     }
 
@@ -2155,18 +2237,22 @@ void MainThread::check_time() {
 }
 
 
-/// UCI::pv() formats PV information according to the UCI protocol. UCI requires
+/// UCI::pv() collects the PV information to be sent to the GUI. UCI requires
 /// that all (if any) unsearched PV lines are sent using a previous search score.
 
-string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
+void UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
 
-  std::stringstream ss;
-  TimePoint elapsed = Time.elapsed() + 1;
   const RootMoves& rootMoves = pos.this_thread()->rootMoves;
   size_t pvIdx = pos.this_thread()->pvIdx;
   size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
-  uint64_t nodesSearched = Threads.nodes_searched();
-  uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  PVInfo info;
+
+  info.time = Time.elapsed() + 1;
+  info.nodes = Threads.nodes_searched();
+  info.tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  info.hashfull = info.time > 1000 ? TT.hashfull() : -1; // Earlier makes little sense
+  info.gamePly = pos.game_ply();
+  info.chess960 = pos.is_chess960();
 
   for (size_t i = 0; i < multiPV; ++i)
   {
@@ -2184,36 +2270,14 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
       bool tb = TB::RootInTB && abs(v) < VALUE_MATE_IN_MAX_PLY;
       v = tb ? rootMoves[i].tbScore : v;
 
-      if (ss.rdbuf()->in_avail()) // Not at first line
-          ss << "\n";
-
-      ss << "info"
-         << " depth "    << d
-         << " seldepth " << rootMoves[i].selDepth
-         << " multipv "  << i + 1
-         << " score "    << UCI::value(v);
-
-      if (Options["UCI_ShowWDL"])
-          ss << UCI::wdl(v, pos.game_ply());
-
-      if (!tb && i == pvIdx)
-          ss << (v >= beta ? " lowerbound" : v <= alpha ? " upperbound" : "");
-
-      ss << " nodes "    << nodesSearched
-         << " nps "      << nodesSearched * 1000 / elapsed;
-
-      if (elapsed > 1000) // Earlier makes little sense
-          ss << " hashfull " << TT.hashfull();
-
-      ss << " tbhits "   << tbHits
-         << " time "     << elapsed
-         << " pv";
+      Bound bound =  tb || i != pvIdx ? BOUND_NONE
+                   : v >= beta        ? BOUND_LOWER
+                   : v <= alpha       ? BOUND_UPPER : BOUND_NONE;
 
-      for (Move m : rootMoves[i].pv)
-          ss << " " << UCI::move(m, pos.is_chess960());
+      info.lines.push_back({ i + 1, d, rootMoves[i].selDepth, v, bound, rootMoves[i].pv });
   }
 
-  return ss.str();
+  UCI::send(std::move(info));
 }
 
 
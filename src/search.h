@@ -85,7 +85,7 @@ struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
     time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
-    movestogo = depth = mate = perft = infinite = 0;
+    movestogo = depth = mate = perft = solve = infinite = 0;
     nodes = 0;
   }
 
@@ -95,7 +95,7 @@ struct LimitsType {
 
   std::vector<Move> searchmoves;
   TimePoint time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
-  int movestogo, depth, mate, perft, infinite;
+  int movestogo, depth, mate, perft, solve, infinite;
   int64_t nodes;
 };
 
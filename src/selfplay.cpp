@@ -0,0 +1,584 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <cmath>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "selfplay.h"
+#include "thread.h"
+#include "uci.h"
+
+namespace SelfPlay {
+
+namespace {
+
+  constexpr int MaxGamePlies = 600; // Adjudicate a draw after this many plies
+
+  // game_over() checks the position for the end of the game, and if so stores
+  // the result from white's point of view.
+  bool game_over(const Position& pos, int& result, std::string& termination) {
+
+    Value v;
+
+    if (pos.is_variant_end())
+        v = pos.variant_result(), termination = "variant end";
+    else if (!MoveList<LEGAL>(pos).size())
+        v = pos.checkers() ? pos.checkmate_value() : pos.stalemate_value(),
+        termination = pos.checkers() ? "checkmate" : "stalemate";
+    // With no search root, is_draw() applies the threefold repetition rule
+    else if (pos.is_draw(0))
+        v = VALUE_DRAW, termination = "draw by rule";
+    else
+        return false;
+
+    result = v == VALUE_DRAW ? 0 : (v > VALUE_DRAW) == (pos.side_to_move() == WHITE) ? 1 : -1;
+    return true;
+  }
+
+  // go_command() returns the "go" command for the given search limits
+  std::string go_command(const Search::LimitsType& limits) {
+
+    std::string cmd = "go";
+
+    if (limits.nodes)
+        cmd += " nodes " + std::to_string(limits.nodes);
+    if (limits.movetime)
+        cmd += " movetime " + std::to_string(limits.movetime);
+    if (limits.depth)
+        cmd += " depth " + std::to_string(limits.depth);
+
+    return cmd;
+  }
+
+  // elo() returns the Elo difference for the given score, between 0 and 1
+  double elo(double score) {
+    return -400 * std::log10(1 / std::clamp(score, 1e-6, 1 - 1e-6) - 1);
+  }
+
+#ifndef _WIN32
+  // make_pipe() creates a pipe whose ends are closed on exec
+  bool make_pipe(int fds[2]) {
+
+#if defined(__linux__)
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds))
+        return false;
+
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+  }
+#endif
+
+} // namespace
+
+
+#ifndef _WIN32
+
+Engine::Engine(const OptionList& options, const std::string& path) {
+
+  int toChild[2], fromChild[2];
+
+  // Writing to an engine that died must fail instead of killing this process
+  signal(SIGPIPE, SIG_IGN);
+
+  // The pipes are closed on exec, so that the engines started later do not
+  // inherit the ends of this one, which would keep it alive after a quit.
+  if (!make_pipe(toChild))
+      return;
+
+  if (!make_pipe(fromChild))
+  {
+      close(toChild[0]);
+      close(toChild[1]);
+      return;
+  }
+
+  pid = fork();
+  if (pid == 0)
+  {
+      dup2(toChild[0], STDIN_FILENO);
+      dup2(fromChild[1], STDOUT_FILENO);
+      close(toChild[0]);
+      close(toChild[1]);
+      close(fromChild[0]);
+      close(fromChild[1]);
+
+      if (!path.empty())
+          execlp(path.c_str(), path.c_str(), (char*)nullptr);
+      else
+      {
+#ifdef __linux__
+          execl("/proc/self/exe", "stockfish", (char*)nullptr);
+#endif
+          execlp(CommandLine::argv0.c_str(), CommandLine::argv0.c_str(), (char*)nullptr);
+      }
+      _exit(EXIT_FAILURE);
+  }
+
+  close(toChild[0]);
+  close(fromChild[1]);
+
+  if (pid < 0)
+  {
+      close(toChild[1]);
+      close(fromChild[0]);
+      return;
+  }
+
+  in  = fdopen(toChild[1], "w");
+  out = fdopen(fromChild[0], "r");
+
+  send("uci");
+  if (!wait_for("id name", &name) || !wait_for("uciok"))
+      return;
+
+  name = name.substr(8);
+
+  set_options(options);
+}
+
+Engine::~Engine() {
+
+  if (in)
+  {
+      send("quit");
+      fclose(in);
+  }
+
+  if (out)
+      fclose(out);
+
+  if (pid > 0)
+      waitpid(pid, nullptr, 0);
+}
+
+#else
+
+// Child processes are not supported on Windows yet, ok() is false
+
+Engine::Engine(const OptionList&, const std::string&) {}
+Engine::~Engine() {}
+
+#endif
+
+
+/// Engine::send() sends a command to the engine
+
+void Engine::send(const std::string& cmd) {
+
+  if (!in)
+      return;
+
+  fputs((cmd + "\n").c_str(), in);
+  fflush(in);
+}
+
+
+/// Engine::wait_for() reads the engine output up to a line starting with the
+/// given token, which is returned in line. It returns false if the engine died.
+
+bool Engine::wait_for(const std::string& token, std::string* line) {
+
+  char buf[8192];
+
+  while (out && fgets(buf, sizeof(buf), out))
+  {
+      std::string s(buf);
+
+      if (s.compare(0, token.size(), token) == 0)
+      {
+          if (line)
+              *line = s.substr(0, s.find_last_not_of("\r\n") + 1);
+          return true;
+      }
+  }
+
+  return false;
+}
+
+
+/// Engine::set_options() sends the given UCI options and waits for the engine
+
+void Engine::set_options(const OptionList& options) {
+
+  for (const auto& o : options)
+      send("setoption name " + o.first + " value " + o.second);
+
+  send("isready");
+  wait_for("readyok");
+}
+
+
+/// play() plays a game from the given position and opening moves, with the
+/// engines searching with the given limits. An engine playing an illegal move
+/// loses the game, an engine dying aborts it.
+
+Game play(Engine& white, Engine& black, Variant v, const std::string& fen,
+          const std::vector<std::string>& opening, const Search::LimitsType& limits) {
+
+  Game game { v, fen, {}, 0, "", false };
+  Engine* engines[COLOR_NB] = { &white, &black };
+  StateListPtr states(new std::deque<StateInfo>(1));
+  Position pos;
+  std::string goCmd = go_command(limits);
+
+  pos.set(fen, false, v, &states->back(), Threads.main());
+
+  for (auto& e : engines)
+      e->send("ucinewgame");
+
+  std::vector<std::string> moves = opening;
+
+  for (size_t i = 0; !game_over(pos, game.result, game.termination); ++i)
+  {
+      std::string token, line;
+      Color us = pos.side_to_move();
+
+      if (i >= opening.size())
+      {
+          if (game.moves.size() >= MaxGamePlies)
+          {
+              game.result = 0, game.termination = "adjudication";
+              break;
+          }
+
+          std::string cmd = "position fen " + fen + " moves";
+          for (const auto& m : game.moves)
+              cmd += " " + m;
+
+          engines[us]->send(cmd);
+          engines[us]->send(goCmd);
+
+          if (!engines[us]->wait_for("bestmove", &line))
+          {
+              game.aborted = true, game.termination = "engine died";
+              break;
+          }
+
+          std::istringstream is(line);
+          is >> token >> token;
+      }
+      else
+          token = opening[i];
+
+      Move m = UCI::to_move(pos, token);
+      if (m == MOVE_NONE)
+      {
+          game.result = us == WHITE ? -1 : 1, game.termination = "illegal move " + token;
+          break;
+      }
+
+      game.moves.push_back(token);
+      states->emplace_back();
+      pos.do_move(m, states->back());
+  }
+
+  return game;
+}
+
+
+/// random_opening() returns a few random legal moves from the given position,
+/// to diversify the games when there is no opening book.
+
+std::vector<std::string> random_opening(Variant v, const std::string& fen, int plies, uint64_t seed) {
+
+  PRNG rng(seed);
+  std::vector<std::string> moves;
+  StateListPtr states(new std::deque<StateInfo>(1));
+  Position pos;
+  int result;
+  std::string termination;
+
+  pos.set(fen, false, v, &states->back(), Threads.main());
+
+  for (int i = 0; i < plies && !game_over(pos, result, termination); ++i)
+  {
+      MoveList<LEGAL> list(pos);
+      Move m = *(list.begin() + rng.rand<uint64_t>() % list.size());
+
+      moves.push_back(UCI::move(m, false));
+      states->emplace_back();
+      pos.do_move(m, states->back());
+  }
+
+  return moves;
+}
+
+
+
+/// pgn() returns the PGN of a game, with the moves in SAN
+
+std::string pgn(const Game& game, const std::string& white, const std::string& black, int round) {
+
+  static const char* Results[] = { "0-1", "1/2-1/2", "1-0" };
+
+  std::string result = game.aborted ? "*" : Results[game.result + 1];
+  std::ostringstream ss;
+  StateListPtr states(new std::deque<StateInfo>(1));
+  Position pos;
+  char date[16];
+  time_t t = time(nullptr);
+
+  strftime(date, sizeof(date), "%Y.%m.%d", localtime(&t));
+  pos.set(game.fen, false, game.variant, &states->back(), Threads.main());
+
+  ss << "[Event \"Self-play match\"]\n"
+     << "[Site \"?\"]\n"
+     << "[Date \"" << date << "\"]\n"
+     << "[Round \"" << round << "\"]\n"
+     << "[White \"" << white << "\"]\n"
+     << "[Black \"" << black << "\"]\n"
+     << "[Result \"" << result << "\"]\n";
+
+  if (game.variant != CHESS_VARIANT)
+      ss << "[Variant \"" << variants[game.variant] << "\"]\n";
+
+  if (game.fen != UCI::start_fen(game.variant))
+      ss << "[SetUp \"1\"]\n[FEN \"" << game.fen << "\"]\n";
+
+  ss << "[Termination \"" << game.termination << "\"]\n\n";
+
+  std::string line;
+
+  for (size_t i = 0; i < game.moves.size(); ++i)
+  {
+      std::string token = game.moves[i];
+      std::string word = (pos.side_to_move() == WHITE || i == 0)
+                        ? std::to_string(pos.game_ply() / 2 + 1) + (pos.side_to_move() == WHITE ? ". " : "... ")
+                        : "";
+      Move m = UCI::to_move(pos, token);
+
+      word += UCI::san(pos, m);
+
+      if (line.size() + word.size() >= 80)
+          ss << line << "\n", line.clear();
+
+      line += (line.empty() ? "" : " ") + word;
+      states->emplace_back();
+      pos.do_move(m, states->back());
+  }
+
+  ss << line << (line.empty() ? "" : " ") << result << "\n\n";
+
+  return ss.str();
+}
+
+
+/// match() plays a match between two engines, by default both this one, and
+/// reports the score and the Elo difference of the first one. The command is:
+///
+///   match [games N] [concurrency N] [nodes N] [movetime N] [depth N]
+///         [book <epd file>] [pgn <pgn file>] [opponent <engine path>]
+///         [option <name>=<value>] [option2 <name>=<value>]
+///
+/// The openings of the book are played twice, with colors reversed, in the
+/// variant set by UCI_Variant. Without a book a few random moves are played
+/// from the starting position. The options are sent to the first or to the
+/// second engine, and each engine process keeps its own hash table. Option
+/// names and values may contain spaces, up to the next keyword of the command.
+/// The games aborted by an engine dying are left out of the score.
+
+void match(std::istream& is) {
+
+  Search::LimitsType limits;
+  OptionList options[2];
+  std::string token, bookFile, pgnFile, opponent;
+  int games = 100, concurrency = std::max(1, int(std::thread::hardware_concurrency()));
+
+  const std::set<std::string> keywords = { "games", "concurrency", "nodes", "movetime", "depth",
+                                           "book", "pgn", "opponent", "option", "option2" };
+  bool pending = false; // The token following an option is already read
+
+  while (pending || is >> token)
+  {
+      pending = false;
+
+      if (token == "games")            is >> games;
+      else if (token == "concurrency") is >> concurrency;
+      else if (token == "nodes")       is >> limits.nodes;
+      else if (token == "movetime")    is >> limits.movetime;
+      else if (token == "depth")       is >> limits.depth;
+      else if (token == "book")        is >> bookFile;
+      else if (token == "pgn")         is >> pgnFile;
+      else if (token == "opponent")    is >> opponent;
+      else if (token == "option" || token == "option2")
+      {
+          OptionList& list = options[token == "option2"];
+          std::string opt;
+
+          while ((pending = bool(is >> token)) && !keywords.count(token))
+              opt += (opt.empty() ? "" : " ") + token;
+
+          size_t eq = opt.find('=');
+          if (eq != std::string::npos)
+              list.emplace_back(opt.substr(0, eq), opt.substr(eq + 1));
+      }
+  }
+
+  if (!limits.nodes && !limits.movetime && !limits.depth)
+      limits.nodes = 10000;
+
+  Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+  std::vector<std::string> book;
+
+  // Read the EPD book, keeping only the FEN fields of each line and skipping
+  // the EPD operations, that start with a letter.
+  if (!bookFile.empty())
+  {
+      std::ifstream file(bookFile);
+      std::string line;
+
+      while (std::getline(file, line))
+      {
+          std::istringstream ls(line.substr(0, line.find(';')));
+          std::string fen, field;
+
+          for (int i = 0; ls >> field && (i < 4 || isdigit(field[0]) || field[0] == '+'); ++i)
+              fen += (i ? " " : "") + field;
+
+          if (!fen.empty())
+              book.push_back(fen);
+      }
+
+      if (book.empty())
+      {
+          sync_cout << "info string cannot read the opening book " << bookFile << sync_endl;
+          return;
+      }
+  }
+
+  std::ofstream pgnOut;
+  if (!pgnFile.empty())
+      pgnOut.open(pgnFile, std::ios::app);
+
+  std::mutex mutex;
+  std::atomic<int> next(0);
+  int wins = 0, losses = 0, draws = 0, aborted = 0;
+  std::string names[2];
+
+  auto worker = [&]() {
+
+      OptionList base = { { "Hash", std::to_string(int(Options["Hash"])) },
+                          { "UCI_Variant", std::string(Options["UCI_Variant"]) } };
+      Engine first(base), second(base, opponent);
+
+      if (!first.ok() || !second.ok())
+      {
+          sync_cout << "info string cannot start the engine processes" << sync_endl;
+          return;
+      }
+
+      first.set_options(options[0]);
+      second.set_options(options[1]);
+
+      {
+          std::lock_guard<std::mutex> lk(mutex);
+          names[0] = first.name, names[1] = second.name;
+          if (names[0] == names[1])
+              names[0] += " (1)", names[1] += " (2)";
+      }
+
+      for (int i = next++; i < games; i = next++)
+      {
+          // Each opening is played twice, the first engine is white in even games
+          int pair = i / 2;
+          std::string fen = book.empty() ? UCI::start_fen(variant) : book[pair % book.size()];
+          std::vector<std::string> opening;
+
+          if (book.empty())
+              opening = random_opening(variant, fen, 4, uint64_t(pair) + 1);
+
+          Game game = i % 2 == 0 ? play(first, second, variant, fen, opening, limits)
+                                 : play(second, first, variant, fen, opening, limits);
+
+          int result = i % 2 == 0 ? game.result : -game.result;
+
+          std::lock_guard<std::mutex> lk(mutex);
+
+          if (pgnOut.is_open())
+              pgnOut << pgn(game, names[i % 2], names[1 - i % 2], i + 1) << std::flush;
+
+          // An engine of this worker died: stop it, the other workers play on
+          if (game.aborted)
+          {
+              ++aborted;
+              sync_cout << "info string game " << i + 1 << " aborted, engine died" << sync_endl;
+              return;
+          }
+
+          (result > 0 ? wins : result < 0 ? losses : draws)++;
+
+          sync_cout << "Score of " << names[0] << " vs " << names[1] << ": "
+                    << wins << " - " << losses << " - " << draws
+                    << " [" << (wins + draws / 2.0) / (wins + losses + draws) << "] "
+                    << wins + losses + draws << sync_endl;
+      }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::min(concurrency, games); ++i)
+      workers.emplace_back(worker);
+
+  for (std::thread& th : workers)
+      th.join();
+
+  if (aborted)
+      sync_cout << "info string " << aborted << " games aborted, not scored" << sync_endl;
+
+  int n = wins + losses + draws;
+  if (!n)
+      return;
+
+  // Elo difference with the 95% confidence interval, from the variance of the
+  // game results.
+  double score = (wins + draws / 2.0) / n;
+  double variance = (  wins   * (1 - score) * (1 - score)
+                     + draws  * (0.5 - score) * (0.5 - score)
+                     + losses * score * score) / n;
+  double margin = 1.95996 * std::sqrt(variance / n);
+
+  sync_cout << std::fixed << std::setprecision(1)
+            << "Elo difference: " << elo(score)
+            << " +/- " << (elo(score + margin) - elo(score - margin)) / 2
+            << ", games " << n << ", score " << std::setprecision(3) << score
+            << std::defaultfloat << sync_endl;
+}
+
+} // namespace SelfPlay
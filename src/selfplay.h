@@ -0,0 +1,83 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SELFPLAY_H_INCLUDED
+#define SELFPLAY_H_INCLUDED
+
+#include <cstdio>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "search.h"
+#include "types.h"
+
+/// The SelfPlay namespace plays games between copies of the engine, each run as
+/// a child process spoken to over UCI, so that they can use different options
+/// (for instance tuned parameters) and run in parallel on all the cores.
+
+namespace SelfPlay {
+
+typedef std::vector<std::pair<std::string, std::string>> OptionList;
+
+/// Engine is a child process running this same executable, or the given one
+
+class Engine {
+public:
+  explicit Engine(const OptionList& options, const std::string& path = "");
+ ~Engine();
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  bool ok() const { return in && out; }
+  void send(const std::string& cmd);
+  bool wait_for(const std::string& token, std::string* line = nullptr);
+  void set_options(const OptionList& options);
+
+  std::string name;
+
+private:
+  int pid = -1;
+  FILE* in = nullptr;  // Child's stdin
+  FILE* out = nullptr; // Child's stdout
+};
+
+/// Game is a finished game with its result, from white's point of view: 1 for
+/// a white win, 0 for a draw and -1 for a black win. A game is aborted, without
+/// result, when an engine dies.
+
+struct Game {
+  Variant variant;
+  std::string fen;
+  std::vector<std::string> moves;
+  int result;
+  std::string termination;
+  bool aborted;
+};
+
+Game play(Engine& white, Engine& black, Variant v, const std::string& fen,
+          const std::vector<std::string>& opening, const Search::LimitsType& limits);
+
+std::vector<std::string> random_opening(Variant v, const std::string& fen, int plies, uint64_t seed);
+std::string pgn(const Game& game, const std::string& white, const std::string& black, int round);
+void match(std::istream& is);
+
+} // namespace SelfPlay
+
+#endif // #ifndef SELFPLAY_H_INCLUDED
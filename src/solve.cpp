@@ -0,0 +1,446 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "solve.h"
+#include "thread.h"
+#include "uci.h"
+
+using Search::Limits;
+
+namespace Solver {
+
+namespace {
+
+  // The proof and disproof numbers are kept from the point of view of the side
+  // to move: phi is the number of leaves to expand to prove that it wins, and
+  // delta to prove that it does not. A node is solved when one of them is zero,
+  // the other one then being Infinite: the numbers of the unsolved nodes stay
+  // below it. They take 64 bits, as the sums over the transpositions grow fast.
+  // The attacker is the side whose win is searched: a draw counts as a win of
+  // the defender.
+  constexpr uint64_t Infinite = 1ULL << 60;
+
+  struct Entry {
+    Key key;
+    uint64_t phi, delta;
+    uint32_t work; // Nodes spent on the subtree, to replace the cheapest one
+    Move move;     // Most promising child, the proof move once solved
+  };
+
+  constexpr int BucketSize = 4;
+
+  struct Bucket {
+    Entry entry[BucketSize];
+  };
+
+  struct Child {
+    Move move;
+    Key key;
+    uint64_t phi, delta;
+    bool fixed;  // Solved, not to be read from the table
+    int pathPly; // See Result
+  };
+
+  // Result is the outcome of mid() for a node. A solved node whose result relies
+  // on a draw by repetition or by the 50 moves rule depends on the path to it,
+  // from the lowest ply given by pathPly, and is not stored in the table, as
+  // another path could give another result. When the repeated positions are
+  // all below the node, the result holds for any path: pathPly is then MAX_PLY.
+  struct Result {
+    uint64_t phi, delta;
+    Move move;
+    int pathPly;
+  };
+
+  enum Status { OPEN, SOLVED, PATH_DRAW };
+
+  std::vector<Bucket> Table;
+  Color Attacker;
+  uint64_t Nodes, NextCheck;
+  TimePoint NextInfo;
+  bool Stopped;
+
+  Entry* probe(Key key) {
+
+    Bucket& b = Table[mul_hi64(key, Table.size())];
+    for (Entry& e : b.entry)
+        if (e.key == key)
+            return &e;
+    return nullptr;
+  }
+
+  void store(Key key, uint64_t phi, uint64_t delta, uint64_t work, Move m) {
+
+    Bucket& b = Table[mul_hi64(key, Table.size())];
+    Entry* replace = b.entry;
+    for (Entry& e : b.entry)
+    {
+        if (e.key == key)
+        {
+            replace = &e;
+            break;
+        }
+        if (e.work < replace->work)
+            replace = &e;
+    }
+    *replace = { key, phi, delta, uint32_t(std::min(work, uint64_t(UINT32_MAX))), m };
+  }
+
+  // evaluate() tells whether the game is over in the given position, and if so
+  // sets its numbers. Otherwise they are initialized from the mobility, so that
+  // the forced moves are tried first. Draws by repetition or by the 50 moves
+  // rule depend on the path, and are not stored in the table.
+  Status evaluate(const Position& pos, int ply, uint64_t& phi, uint64_t& delta) {
+
+    Value v;
+    Status status = SOLVED;
+
+    if (pos.is_variant_end())
+        v = pos.variant_result(ply, VALUE_DRAW);
+    else if (pos.is_draw(ply) || ply >= MAX_PLY)
+        v = VALUE_DRAW, status = PATH_DRAW;
+    else
+    {
+        size_t n = MoveList<LEGAL>(pos).size();
+        if (n)
+        {
+            phi = 1, delta = n;
+            return OPEN;
+        }
+        v = pos.checkers() ? pos.checkmate_value(ply) : pos.stalemate_value(ply, VALUE_DRAW);
+    }
+
+    bool win = v > VALUE_DRAW || (v == VALUE_DRAW && pos.side_to_move() != Attacker);
+    phi = win ? 0 : Infinite;
+    delta = win ? Infinite : 0;
+    return status;
+  }
+
+  // draw_ply() returns the lowest ply of the path a draw by the rules depends on:
+  // the one of the repeated position when it is below the root, else the root.
+  int draw_ply(const Position& pos, int ply) {
+
+    int rep = pos.state()->repetition;
+    return pos.rule50_count() <= 99 && rep > 0 && rep < ply && ply < MAX_PLY ? ply - rep : 0;
+  }
+
+  void check_limits() {
+
+    TimePoint elapsed = now() - Limits.startTime;
+
+    if (   Threads.stop
+        || (Limits.movetime && elapsed >= Limits.movetime)
+        || (Limits.nodes && Nodes >= uint64_t(Limits.nodes)))
+        Stopped = true;
+
+    if (elapsed >= NextInfo)
+    {
+        NextInfo = elapsed + 1000;
+        sync_cout << "info nodes " << Nodes
+                  << " nps " << Nodes * 1000 / std::max(elapsed, TimePoint(1))
+                  << " time " << elapsed << sync_endl;
+    }
+    NextCheck = Nodes + 4096;
+  }
+
+  // mid() expands the given node until its numbers reach one of the thresholds,
+  // going down the child with the smallest delta. The thresholds of the child
+  // use the 1 + epsilon trick, that stays longer in a subtree when the second
+  // best child is close, to avoid switching back and forth between them.
+  Result mid(Position& pos, int ply, uint64_t thPhi, uint64_t thDelta) {
+
+    StateInfo st;
+    std::vector<Child> children;
+    uint64_t nodesBefore = Nodes;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        Child c;
+        c.move = m;
+        pos.do_move(m, st);
+        ++Nodes;
+        c.key = pos.key();
+        Status status = evaluate(pos, ply + 1, c.phi, c.delta);
+        c.pathPly = status == PATH_DRAW ? draw_ply(pos, ply + 1) : MAX_PLY;
+        pos.undo_move(m);
+        c.fixed = status != OPEN;
+        if (status == SOLVED)
+            store(c.key, c.phi, c.delta, 1, MOVE_NONE);
+        children.push_back(c);
+    }
+
+    assert(!children.empty());
+
+    uint64_t phi, delta;
+    Move best;
+    int pathPly;
+
+    while (true)
+    {
+        Child* c1 = nullptr;
+        uint64_t delta2 = Infinite;
+        delta = 0;
+
+        for (Child& c : children)
+        {
+            if (!c.fixed)
+                if (const Entry* e = probe(c.key))
+                    c.phi = e->phi, c.delta = e->delta;
+
+            // Saturate the sum below Infinite, that is only for a solved node
+            delta =  delta == Infinite || c.phi == Infinite ? Infinite
+                   : std::min(delta + c.phi, Infinite - 1);
+
+            // Prefer the proof that depends the least on the path
+            if (   !c1 || c.delta < c1->delta
+                || (c.delta == 0 && c1->delta == 0 && c.pathPly > c1->pathPly))
+            {
+                delta2 = c1 ? c1->delta : Infinite;
+                c1 = &c;
+            }
+            else
+                delta2 = std::min(delta2, c.delta);
+        }
+
+        phi = c1->delta;
+        best = c1->move;
+
+        // A win depends on the path if its proof does, a loss if any child does
+        pathPly = phi == 0 ? c1->pathPly : MAX_PLY;
+        if (delta == 0)
+            for (const Child& c : children)
+                pathPly = std::min(pathPly, c.pathPly);
+        if (pathPly >= ply)
+            pathPly = MAX_PLY;
+
+        if (phi >= thPhi || delta >= thDelta || Stopped)
+            break;
+
+        uint64_t childThPhi = thDelta - delta + c1->phi;
+        uint64_t childThDelta = std::min(thPhi, delta2 + delta2 / 4 + 1);
+
+        pos.do_move(best, st);
+        Result r = mid(pos, ply + 1, std::min(childThPhi, Infinite), childThDelta);
+        pos.undo_move(best);
+
+        c1->phi = r.phi, c1->delta = r.delta;
+        c1->pathPly = r.pathPly;
+        c1->fixed = r.pathPly < MAX_PLY;
+
+        if (Nodes >= NextCheck)
+            check_limits();
+    }
+
+    if (pathPly == MAX_PLY)
+        store(pos.key(), phi, delta, Nodes - nodesBefore + 1, best);
+
+    return { phi, delta, best, pathPly };
+  }
+
+  // resistance() returns the move of a lost position that leads to the largest
+  // proof, as the best try of the defender.
+  Move resistance(Position& pos) {
+
+    Move best = MOVE_NONE;
+    uint32_t bestWork = 0;
+    StateInfo st;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        const Entry* e = probe(pos.key());
+        pos.undo_move(m);
+        if (!best || (e && e->work > bestWork))
+            best = m, bestWork = e ? e->work : 0;
+    }
+    return best;
+  }
+
+  // proof_moves() returns the moves of the proof tree at a solved node: the
+  // proof move when the side to move wins, and all the moves when it loses.
+  std::vector<Move> proof_moves(const Position& pos) {
+
+    std::vector<Move> moves;
+    const Entry* e = probe(pos.key());
+
+    if (e && e->phi == 0)
+        moves.push_back(e->move);
+    else if (e && e->delta == 0)
+        for (const auto& m : MoveList<LEGAL>(pos))
+            moves.push_back(m);
+    return moves;
+  }
+
+  // dump() writes the proof tree below the given position, one move per line
+  // indented by its ply. Transpositions are expanded only once.
+  void dump(Position& pos, int ply, std::ostream& os, std::unordered_set<Key>& seen) {
+
+    StateInfo st;
+
+    for (Move m : proof_moves(pos))
+    {
+        uint64_t phi, delta;
+
+        os << std::string(2 * ply, ' ') << UCI::move(m, pos.is_chess960());
+        pos.do_move(m, st);
+
+        Status status = evaluate(pos, ply + 1, phi, delta);
+        if (status != OPEN)
+            os << (status == PATH_DRAW ? " draw\n" : " end\n");
+        else if (!seen.insert(pos.key()).second)
+            os << " transposition\n";
+        else if (proof_moves(pos).empty())
+            os << " unknown\n"; // Overwritten in the table, or solved on its path only
+        else
+        {
+            os << "\n";
+            dump(pos, ply + 1, os, seen);
+        }
+        pos.undo_move(m);
+    }
+  }
+
+  // principal_variation() follows the proof moves of the winner and the best
+  // defence of the loser, as far as they are in the table.
+  std::string principal_variation(Position& pos) {
+
+    std::stringstream ss;
+    std::deque<StateInfo> states;
+    std::vector<Move> moves;
+
+    for (int ply = 0; ply < MAX_PLY; ++ply)
+    {
+        uint64_t phi, delta;
+        const Entry* e = probe(pos.key());
+
+        if (   (ply && evaluate(pos, ply, phi, delta) != OPEN)
+            || !e || (e->phi && e->delta))
+            break;
+
+        Move m = e->phi == 0 ? e->move : resistance(pos);
+        ss << " " << UCI::move(m, pos.is_chess960());
+        states.emplace_back();
+        pos.do_move(m, states.back());
+        moves.push_back(m);
+    }
+
+    for (auto it = moves.rbegin(); it != moves.rend(); ++it)
+        pos.undo_move(*it);
+
+    return ss.str();
+  }
+
+  // run() searches the root until it is solved for the given attacker, or the
+  // search is stopped.
+  Result run(Position& pos, Color attacker) {
+
+    Attacker = attacker;
+    std::fill(Table.begin(), Table.end(), Bucket());
+
+    return mid(pos, 0, Infinite, Infinite);
+  }
+
+} // namespace
+
+
+/// Solver::solve() first tries to prove a win of the side to move, then, if
+/// this is disproved, a win of the opponent, so that a failure of both proves a
+/// draw. It prints the result and a principal variation, writes the proof tree
+/// to the SolveTree file, and outputs the proof move as the best move.
+
+void solve(Position& pos) {
+
+  Color us = pos.side_to_move();
+  uint64_t phi, delta;
+  std::string result = "unknown";
+  Move bestMove = MOVE_NONE;
+
+  Table.resize(size_t(Options["SolveHash"]) * 1024 * 1024 / sizeof(Bucket));
+  Nodes = 0;
+  NextCheck = 4096;
+  NextInfo = 1000;
+  Stopped = false;
+  Attacker = us;
+
+  if (evaluate(pos, 0, phi, delta) != OPEN)
+      result = "game over";
+  else
+  {
+      Result root = run(pos, us);
+
+      if (root.phi == 0)
+          result = "win", bestMove = root.move;
+
+      else if (root.delta == 0)
+      {
+          root = run(pos, ~us);
+
+          if (root.phi == 0)
+              result = "draw", bestMove = root.move;
+          else if (root.delta == 0)
+              result = "loss", bestMove = resistance(pos);
+          else
+              result = "no win", bestMove = root.move;
+      }
+      else
+          bestMove = root.move;
+  }
+
+  TimePoint elapsed = now() - Limits.startTime;
+
+  sync_cout << "info nodes " << Nodes
+            << " nps " << Nodes * 1000 / std::max(elapsed, TimePoint(1))
+            << " time " << elapsed
+            << " pv" << principal_variation(pos) << sync_endl;
+  sync_cout << "info string solve " << result << sync_endl;
+
+  std::string path = Options["SolveTree"];
+  if (   !path.empty() && path != "<empty>"
+      && (result == "win" || result == "loss" || result == "draw"))
+  {
+      std::ofstream file(path);
+      std::unordered_set<Key> seen = { pos.key() };
+
+      file << pos.fen() << " " << result << "\n";
+      dump(pos, 0, file, seen);
+      sync_cout << "info string proof tree of " << seen.size()
+                << " positions written to " << path << sync_endl;
+  }
+
+  std::vector<Bucket>().swap(Table); // Only allocated while solving
+
+  // As for the search, wait for "stop" or "ponderhit" before the best move
+  while (!Threads.stop && (Threads.main()->ponder || Limits.infinite))
+  {}
+
+  sync_cout << "bestmove " << UCI::move(bestMove, pos.is_chess960()) << sync_endl;
+}
+
+} // namespace Solver
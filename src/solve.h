@@ -0,0 +1,37 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SOLVE_H_INCLUDED
+#define SOLVE_H_INCLUDED
+
+class Position;
+
+/// The Solver namespace implements the 'go solve' command: a depth-first
+/// proof-number search (df-pn) that proves a win, a loss or a draw of the side
+/// to move, instead of estimating a score. It suits the positions decided by
+/// long forced sequences, like the compulsory captures of antichess and losers
+/// or the endgames of atomic and racing kings. It uses its own transposition
+/// table of SolveHash MB, and writes the proof tree to the SolveTree file.
+
+namespace Solver {
+
+void solve(Position& pos);
+
+} // namespace Solver
+
+#endif // #ifndef SOLVE_H_INCLUDED
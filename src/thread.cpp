@@ -79,6 +79,7 @@ Thread::~Thread() {
 
 void Thread::clear() {
 
+  evalCache.resize(size_t(Options["EvalCache"]));
   counterMoves.fill(MOVE_NONE);
   mainHistory.fill(0);
   lowPlyHistory.fill(0);
@@ -115,6 +116,16 @@ void Thread::wait_for_search_finished() {
 }
 
 
+/// Thread::is_searching() tells, without blocking, whether the thread is
+/// still searching.
+
+bool Thread::is_searching() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+  return searching;
+}
+
+
 /// Thread::idle_loop() is where the thread is parked, blocked on the
 /// condition variable, when it has no work to do.
 
@@ -223,6 +234,9 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   for (Thread* th : *this)
   {
       th->nodes = th->tbHits = th->nmpMinPly = th->bestMoveChanges = 0;
+      th->evalCache.probes = th->evalCache.hits = 0;
+      th->materialProbes = th->materialHits = 0;
+      std::fill(th->evalPaths, th->evalPaths + Eval::EVAL_PATH_NB, 0);
       th->rootDepth = th->completedDepth = 0;
       th->rootMoves = rootMoves;
       th->rootPos.set(pos.fen(), pos.is_chess960(), pos.subvariant(), &th->rootState, th);
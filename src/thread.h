@@ -29,6 +29,7 @@
 #endif
 #include <vector>
 
+#include "evaluate.h"
 #include "material.h"
 #include "movepick.h"
 #include "pawns.h"
@@ -62,10 +63,14 @@ public:
   void idle_loop();
   void start_searching();
   void wait_for_search_finished();
+  bool is_searching();
 
   Pawns::Table pawnsTable;
   Material::Table materialTable;
-  size_t pvIdx, pvLast;
+  Eval::Cache evalCache;
+  uint64_t evalPaths[Eval::EVAL_PATH_NB];
+  uint64_t materialProbes, materialHits;
+  size_t pvIdx, pvLast, pvWidth;
   uint64_t ttHitAverage;
   int selDepth, nmpMinPly;
   Color nmpColor;
@@ -119,6 +124,7 @@ struct ThreadPool : public std::vector<Thread*> {
   Thread* get_best_thread() const;
   void start_searching();
   void wait_for_search_finished() const;
+  StateListPtr release_setup_states() { return std::move(setupStates); }
 
   std::atomic_bool stop, increaseDepth;
 
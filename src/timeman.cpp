@@ -26,7 +26,10 @@
 
 TimeManagement Time; // Our global time management object
 
-constexpr int MoveHorizon[VARIANT_NB] = { // Plan time management at most this many moves ahead
+// Plan time management at most MaxHorizon moves ahead, with all the material
+// still on the board, and at least MinHorizon moves ahead when the game is about
+// to be decided. Standard chess keeps a fixed horizon.
+constexpr int MaxHorizon[VARIANT_NB] = {
   50,
 #ifdef ANTI
   29,
@@ -63,12 +66,99 @@ constexpr int MoveHorizon[VARIANT_NB] = { // Plan time management at most this m
 #endif
 };
 
+constexpr int MinHorizon[VARIANT_NB] = {
+  50,
+#ifdef ANTI
+  8,
+#endif
+#ifdef ATOMIC
+  10,
+#endif
+#ifdef CRAZYHOUSE
+  25,
+#endif
+#ifdef EXTINCTION
+  20,
+#endif
+#ifdef GRID
+  25,
+#endif
+#ifdef HORDE
+  20,
+#endif
+#ifdef KOTH
+  15,
+#endif
+#ifdef LOSERS
+  12,
+#endif
+#ifdef RACE
+  4,
+#endif
+#ifdef THREECHECK
+  12,
+#endif
+#ifdef TWOKINGS
+  25,
+#endif
+};
+
+/// TimeManagement::move_horizon() estimates the number of moves still to be
+/// played by the side to move. The horizon shrinks with the material left on
+/// the board (and in hand, where the pieces in hand also speed up the attack)
+/// and with the distance to the variant goals: checks still to be given, king
+/// distance to the center or to the eighth rank.
+
+int TimeManagement::move_horizon(const Position& pos) const {
+
+  Variant var = pos.variant();
+  int maxMoves = MaxHorizon[var], minMoves = MinHorizon[var];
+
+  if (fixedHorizon || minMoves == maxMoves)
+      return maxMoves;
+
+  // Material left, from 0 (bare kings) to 78 (initial material of both sides)
+  int material =       pos.count<PAWN>()
+                 + 3 * (pos.count<KNIGHT>() + pos.count<BISHOP>())
+                 + 5 *  pos.count<ROOK>()
+                 + 9 *  pos.count<QUEEN>();
+  int moves = minMoves + (maxMoves - minMoves) * std::min(material, 78) / 78;
+
+#ifdef CRAZYHOUSE
+  if (pos.is_house())
+      moves -= (  pos.count_in_hand<ALL_PIECES>(WHITE)
+                + pos.count_in_hand<ALL_PIECES>(BLACK)) / 2;
+#endif
+#ifdef THREECHECK
+  if (pos.is_three_check())
+      moves = std::min(moves, minMoves + 8 * (CHECKS_3 - std::max(pos.checks_given(WHITE), pos.checks_given(BLACK))));
+#endif
+#ifdef KOTH
+  if (pos.is_koth())
+  {
+      int d = 7;
+      for (Color c : { WHITE, BLACK })
+          for (Bitboard b = Center; b; )
+              d = std::min(d, distance(pos.square<KING>(c), pop_lsb(&b)));
+      moves = std::min(moves, minMoves + 4 * d);
+  }
+#endif
+#ifdef RACE
+  if (pos.is_race())
+      moves = std::min(moves, minMoves + 2 * (RANK_8 - std::max(rank_of(pos.square<KING>(WHITE)),
+                                                                rank_of(pos.square<KING>(BLACK)))));
+#endif
+
+  return std::clamp(moves, minMoves, maxMoves);
+}
+
+
 /// TimeManagement::init() is called at the beginning of the search and calculates
 /// the bounds of time allowed for the current game ply. We currently support:
 //      1) x basetime (+ z increment)
 //      2) x moves in y seconds (+ z increment)
 
-void TimeManagement::init(Variant var, Search::LimitsType& limits, Color us, int ply) {
+void TimeManagement::init(const Position& pos, Search::LimitsType& limits, Color us, int ply) {
 
   TimePoint moveOverhead    = TimePoint(Options["Move Overhead"]);
   TimePoint slowMover       = TimePoint(Options["Slow Mover"]);
@@ -95,8 +185,9 @@ void TimeManagement::init(Variant var, Search::LimitsType& limits, Color us, int
 
   startTime = limits.startTime;
 
-  // Maximum move horizon of 50 moves
-  int mtg = limits.movestogo ? std::min(limits.movestogo, MoveHorizon[var]) : MoveHorizon[var];
+  // Estimated number of moves left in the game, at most 50 moves
+  int horizon = move_horizon(pos);
+  int mtg = limits.movestogo ? std::min(limits.movestogo, horizon) : horizon;
 
   // Make sure timeLeft is > 0 since we may use it as a divisor
   TimePoint timeLeft =  std::max(TimePoint(1),
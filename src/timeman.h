@@ -28,13 +28,15 @@
 
 class TimeManagement {
 public:
-  void init(Variant var, Search::LimitsType& limits, Color us, int ply);
+  void init(const Position& pos, Search::LimitsType& limits, Color us, int ply);
+  int move_horizon(const Position& pos) const;
   TimePoint optimum() const { return optimumTime; }
   TimePoint maximum() const { return maximumTime; }
   TimePoint elapsed() const { return Search::Limits.npmsec ?
                                      TimePoint(Threads.nodes_searched()) : now() - startTime; }
 
   int64_t availableNodes; // When in 'nodes as time' mode
+  bool fixedHorizon;      // Ignore the position when planning, see move_horizon()
 
 private:
   TimePoint startTime;
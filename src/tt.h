@@ -83,8 +83,14 @@ public:
   void new_search() { generation8 += GENERATION_DELTA; } // Lower bits are used for other things
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
+  size_t size_mb() const { return clusterCount * sizeof(Cluster) / (1024 * 1024); }
   void resize(size_t mbSize);
   void clear();
+  void swap(TranspositionTable& tt) {
+    std::swap(clusterCount, tt.clusterCount);
+    std::swap(table, tt.table);
+    std::swap(generation8, tt.generation8);
+  }
 
   TTEntry* first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
@@ -93,9 +99,9 @@ public:
 private:
   friend struct TTEntry;
 
-  size_t clusterCount;
-  Cluster* table;
-  uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  size_t clusterCount = 0;
+  Cluster* table = nullptr;
+  uint8_t generation8 = 0; // Size must be not bigger than TTEntry::genBound8
 };
 
 extern TranspositionTable TT;
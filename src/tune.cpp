@@ -17,11 +17,16 @@
 */
 
 #include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include "types.h"
 #include "misc.h"
+#include "selfplay.h"
 #include "uci.h"
 
 using std::string;
@@ -31,6 +36,10 @@ const UCI::Option* LastOption = nullptr;
 BoolConditions Conditions;
 static std::map<std::string, int> TuneResults;
 
+// The parameters exported as UCI options, for the built-in SPSA tuner
+struct TuneParam { string name; double value; int min, max; };
+static std::vector<TuneParam> TuneParams;
+
 string Tune::next(string& names, bool pop) {
 
   string name;
@@ -67,6 +76,7 @@ static void make_option(const string& n, int v, const SetRange& r) {
 
   Options[n] << UCI::Option(v, r(v).first, r(v).second, on_tune);
   LastOption = &Options[n];
+  TuneParams.push_back({ n, double(v), r(v).first, r(v).second });
 
   // Print formatted parameters, ready to be copy-pasted in Fishtest
   std::cout << n << ","
@@ -127,6 +137,156 @@ void BoolConditions::set() {
 }
 
 
+/// Tune::spsa() tunes the parameters flagged with TUNE() by playing game pairs
+/// between two copies of the engine, with the parameters shifted in opposite
+/// random directions, and moving the parameters towards the winner, as done
+/// by fishtest. The command is:
+///
+///   tune spsa [iterations] [nodes] [concurrency] [log file]
+///
+/// where an iteration is a game pair played with nodes per move, and the games
+/// are played in the variant set by UCI_Variant. Every iteration is logged, and
+/// the final values are printed in fishtest format, ready for read_results().
+
+void Tune::spsa(std::istream& is) {
+
+  int iterations = 1000, nodes = 5000;
+  int concurrency = std::max(1, int(std::thread::hardware_concurrency()));
+  string logFile;
+
+  is >> iterations >> nodes >> concurrency >> logFile;
+
+  if (TuneParams.empty())
+  {
+      sync_cout << "info string no parameters to tune, flag them with TUNE()" << sync_endl;
+      return;
+  }
+
+  Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+  string fen = UCI::start_fen(variant);
+  Search::LimitsType limits;
+  limits.nodes = nodes;
+
+  // Fishtest SPSA hyperparameters, with the same defaults
+  const double alpha = 0.602, gamma = 0.101, rEnd = 0.002;
+  const double N = iterations, A = 0.1 * N;
+
+  std::vector<double> c(TuneParams.size()), a(TuneParams.size());
+  for (size_t i = 0; i < TuneParams.size(); ++i)
+  {
+      double cEnd = (TuneParams[i].max - TuneParams[i].min) / 20.0;
+      c[i] = cEnd * std::pow(N, gamma);
+      a[i] = rEnd * cEnd * cEnd * std::pow(A + N, alpha);
+  }
+
+  std::ofstream log;
+  if (!logFile.empty())
+      log.open(logFile);
+
+  std::mutex mutex;
+  int k = 0, finished = 0;
+  double score = 0;
+
+  auto worker = [&](int id) {
+
+      SelfPlay::OptionList base = { { "Hash", "8" },
+                                    { "UCI_Variant", string(Options["UCI_Variant"]) } };
+      SelfPlay::Engine plus(base), minus(base);
+      PRNG rng(uint64_t(now()) * (id + 1) + 1);
+
+      if (!plus.ok() || !minus.ok())
+      {
+          sync_cout << "info string cannot start the engine processes" << sync_endl;
+          return;
+      }
+
+      while (true)
+      {
+          SelfPlay::OptionList optPlus, optMinus;
+          std::vector<double> delta(TuneParams.size()), ck(TuneParams.size());
+          int iter;
+
+          {
+              std::lock_guard<std::mutex> lk(mutex);
+
+              if ((iter = k++) >= iterations)
+                  return;
+
+              for (size_t i = 0; i < TuneParams.size(); ++i)
+              {
+                  TuneParam& p = TuneParams[i];
+                  delta[i] = rng.rand<uint64_t>() & 1 ? 1 : -1;
+                  ck[i] = c[i] / std::pow(iter + 1, gamma);
+
+                  auto clamped = [&](double v) {
+                      return std::to_string(std::clamp(int(std::lround(v)), p.min, p.max));
+                  };
+                  optPlus.emplace_back(p.name, clamped(p.value + ck[i] * delta[i]));
+                  optMinus.emplace_back(p.name, clamped(p.value - ck[i] * delta[i]));
+              }
+          }
+
+          plus.set_options(optPlus);
+          minus.set_options(optMinus);
+
+          // A game pair from the same opening with colors reversed, and the
+          // result from the point of view of the plus engine: wins minus losses,
+          // as the step of fishtest.
+          auto opening = SelfPlay::random_opening(variant, fen, 4, rng.rand<uint64_t>() | 1);
+          SelfPlay::Game first  = SelfPlay::play(plus, minus, variant, fen, opening, limits);
+          SelfPlay::Game second = SelfPlay::play(minus, plus, variant, fen, opening, limits);
+          int result = first.result - second.result;
+
+          std::lock_guard<std::mutex> lk(mutex);
+
+          // A dead engine gives no result, stop this worker without an update
+          if (first.aborted || second.aborted)
+          {
+              sync_cout << "info string spsa iteration " << iter + 1 << " aborted, engine died" << sync_endl;
+              return;
+          }
+
+          score += result / 2.0;
+          ++finished;
+
+          for (size_t i = 0; i < TuneParams.size(); ++i)
+          {
+              TuneParam& p = TuneParams[i];
+              double ak = a[i] / std::pow(A + iter + 1, alpha);
+              p.value = std::clamp(p.value + ak / ck[i] * result * delta[i],
+                                   double(p.min), double(p.max));
+          }
+
+          if (log.is_open())
+          {
+              log << "iteration " << finished << " result " << result;
+              for (const TuneParam& p : TuneParams)
+                  log << " " << p.name << " " << p.value;
+              log << std::endl;
+          }
+
+          if (finished % 10 == 0 || finished == iterations)
+              sync_cout << "info string spsa iteration " << finished << "/" << iterations
+                        << " score " << score / finished << sync_endl;
+      }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < concurrency; ++i)
+      workers.emplace_back(worker, i);
+
+  for (std::thread& th : workers)
+      th.join();
+
+  // Set the tuned values in the options, that are the ones used for search
+  for (const TuneParam& p : TuneParams)
+  {
+      Options[p.name] = std::to_string(int(std::lround(p.value)));
+      sync_cout << "param: " << p.name << ", best: " << p.value << sync_endl;
+  }
+}
+
+
 // Init options with tuning session results instead of default values. Useful to
 // get correct bench signature after a tuning session or to test tuned values.
 // Just copy fishtest tuning results in a result.txt file and extract the
@@ -136,8 +296,6 @@ void BoolConditions::set() {
 //
 // Then paste the output below, as the function body
 
-#include <cmath>
-
 void Tune::read_results() {
 
   /* ...insert your values here... */
@@ -19,6 +19,7 @@
 #ifndef TUNE_H_INCLUDED
 #define TUNE_H_INCLUDED
 
+#include <iosfwd>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -91,6 +92,11 @@ inline void set_conditions() { Conditions.set(); }
 /// once, after the engine receives the last UCI option, that is the one defined
 /// and created as the last one, so the GUI should send the options in the same
 /// order in which have been defined.
+///
+/// The parameters can then be tuned in a fishtest session, or locally with the
+/// "tune spsa [iterations] [nodes] [concurrency] [log file]" command, that plays
+/// game pairs between copies of the engine and prints the results in the same
+/// format as fishtest.
 
 class Tune {
 
@@ -174,6 +180,7 @@ public:
   }
   static void init() { for (auto& e : instance().list) e->init_option(); read_options(); } // Deferred, due to UCI::Options access
   static void read_options() { for (auto& e : instance().list) e->read_option(); }
+  static void spsa(std::istream& is);
   static bool update_on_last;
 };
 
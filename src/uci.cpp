@@ -17,16 +17,26 @@
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 
+#include "book.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "position.h"
 #include "search.h"
+#include "selfplay.h"
 #include "thread.h"
 #include "timeman.h"
 #include "tt.h"
@@ -113,6 +123,16 @@ namespace {
 #endif
   };
 
+  // The position last set up by position(). GUIs send the whole move list of
+  // the game every move, so when a new command extends it we only need to play
+  // the new moves on top of the existing StateInfo history.
+  struct Setup {
+    string fen;
+    Variant variant;
+    bool chess960;
+    vector<string> moves;
+  } LastSetup;
+
 
   // position() is called when engine receives the "position" UCI command.
   // The function sets up the position described in the given FEN string ("fen")
@@ -138,17 +158,179 @@ namespace {
     else
         return;
 
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], variant, &states->back(), Threads.main());
+    vector<string> moves;
+    while (is >> token)
+        moves.push_back(token);
+
+    bool chess960 = Options["UCI_Chess960"];
+    size_t played = LastSetup.moves.size();
+
+    bool extends =   fen == LastSetup.fen
+                  && variant == LastSetup.variant
+                  && chess960 == LastSetup.chess960
+                  && played <= moves.size()
+                  && std::equal(LastSetup.moves.begin(), LastSetup.moves.end(), moves.begin());
+
+    // After 'go' the history is owned by the threads, take it back only once
+    // their search is over, as they refer to it until then. While they still
+    // search, set up a new history instead, so that "stop" can still be read.
+    if (extends && !states)
+    {
+        if (!Threads.main()->is_searching())
+            states = Threads.release_setup_states();
+        extends = bool(states);
+    }
+
+    if (!extends)
+    {
+        states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
+        pos.set(fen, chess960, variant, &states->back(), Threads.main());
+        LastSetup = { fen, variant, chess960, {} };
+        played = 0;
+    }
 
     // Parse move list (if any)
-    while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
+    for (size_t i = played; i < moves.size() && (m = UCI::to_move(pos, moves[i])) != MOVE_NONE; ++i)
     {
         states->emplace_back();
         pos.do_move(m, states->back());
+        LastSetup.moves.push_back(moves[i]);
+    }
+  }
+
+#ifdef BUGHOUSE
+  // Pieces passed by the partner board in the current game, by side and piece
+  // type, used to predict the inflow of pieces during the search.
+  int Received[COLOR_NB][PIECE_TYPE_NB];
+
+  // holding() is called when engine receives the "holding" or the "partner"
+  // command in bughouse. The first one sets the pieces in hand of both sides,
+  // e.g. "holding [QNpp]", the second one adds pieces passed by the partner
+  // board, e.g. "partner N". Only the hands change, so the history and the
+  // transposition table are kept for the next search.
+
+  void holding(Position& pos, istringstream& is, bool add) {
+
+    if (!pos.is_bughouse())
+    {
+        sync_cout << "info string pieces in hand can only be passed in bughouse" << sync_endl;
+        return;
+    }
+
+    string token, pieces;
+    while (is >> token)
+        pieces += token;
+
+    int before[COLOR_NB][PIECE_TYPE_NB];
+    for (Color c : { WHITE, BLACK })
+        for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+            before[c][pt] = pos.count_in_hand(c, pt);
+
+    pos.set_holdings(pieces, add);
+    LastSetup.fen.clear(); // The moves alone do not give this position anymore
+
+    for (Color c : { WHITE, BLACK })
+        for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+            Received[c][pt] += std::max(pos.count_in_hand(c, pt) - before[c][pt], 0);
+  }
+#endif
+
+
+  // In server mode each game has its own part of the hash memory, the game
+  // searched uses the global TT while the others keep theirs here. The hash
+  // of the least recently used games is freed when the "Hash" budget runs out.
+  struct Game {
+    TranspositionTable tt;
+    int64_t availableNodes;
+    uint64_t lastUsed;
+  };
+
+  std::map<string, Game> Games;
+  string CurrentGame;
+  uint64_t GameClock;
+
+  // hash_used() returns the size in MB of the hash tables of all the games,
+  // computed from the tables themselves so that it follows any resize.
+
+  size_t hash_used() {
+
+    size_t used = TT.size_mb();
+    for (const auto& g : Games)
+        used += g.second.tt.size_mb();
+    return used;
+  }
+
+  // free_games() frees the hash of the least recently used games, except the
+  // current one, until 'mb' more MB fit in the "Hash" budget.
+
+  void free_games(size_t mb) {
+
+    size_t used = hash_used(), budget = size_t(Options["Hash"]);
+
+    while (used + mb > budget)
+    {
+        auto lru = Games.end();
+        for (auto it = Games.begin(); it != Games.end(); ++it)
+            if (   it->first != CurrentGame
+                && (lru == Games.end() || it->second.lastUsed < lru->second.lastUsed))
+                lru = it;
+
+        if (lru == Games.end())
+            break;
+
+        used -= lru->second.tt.size_mb();
+        Games.erase(lru);
+    }
+  }
+
+  // switch_game() is called when engine receives the "game" command, sent
+  // before the commands for a game, e.g. "game 42". The histories are shared
+  // between the games, "ucinewgame" then only clears the hash of the game.
+  // Without argument it lists the games and their hash size.
+
+  void switch_game(istringstream& is) {
+
+    string id;
+
+    if (!(is >> id))
+    {
+        for (const auto& g : Games)
+            sync_cout << "info string game " << g.first << (g.first == CurrentGame ? " (current)" : "")
+                      << " hash " << (g.first == CurrentGame ? TT : g.second.tt).size_mb() << " MB" << sync_endl;
+        return;
+    }
+
+    if (!Games.empty() && id == CurrentGame)
+        return;
+
+    Threads.main()->wait_for_search_finished();
+
+    // The first game takes over the hash used so far, as an idle game
+    Game& current = Games[CurrentGame];
+    TT.swap(current.tt);
+    current.availableNodes = Time.availableNodes;
+    current.lastUsed = ++GameClock;
+
+    CurrentGame = id;
+    auto it = Games.find(id);
+    if (it == Games.end())
+    {
+        // Free the least recently used games until the new one fits
+        free_games(size_t(Options["GameHash"]));
+
+        size_t used = hash_used(), budget = size_t(Options["Hash"]);
+        it = Games.try_emplace(id).first;
+        it->second.tt.resize(std::max(size_t(1), std::min(size_t(Options["GameHash"]), used < budget ? budget - used : 0)));
+        it->second.availableNodes = 0;
     }
+
+    TT.swap(it->second.tt);
+    Time.availableNodes = it->second.availableNodes;
+    it->second.lastUsed = ++GameClock;
+    LastSetup.fen.clear(); // The history is the one of the previous game
   }
 
+
   // trace_eval() prints the evaluation for the current position, consistent with the UCI
   // options set so far.
 
@@ -159,6 +341,7 @@ namespace {
     p.set(pos.fen(), Options["UCI_Chess960"], pos.variant(), &states->back(), Threads.main());
 
 #ifdef USE_NNUE
+    Eval::NNUE::load();
     Eval::NNUE::verify();
 #endif
 
@@ -185,6 +368,11 @@ namespace {
     if (Options.count(name))
     {
         Options[name] = value;
+
+        // The history may hold state computed with the previous options, like
+        // the NNUE accumulators of another net: set it up again next time.
+        LastSetup.fen.clear();
+
         std::transform(name.begin(), name.end(), name.begin(), ::tolower);
         if (name == "uci_variant") {
             Variant variant = UCI::variant_from_name(value);
@@ -224,13 +412,45 @@ namespace {
         else if (token == "movetime")  is >> limits.movetime;
         else if (token == "mate")      is >> limits.mate;
         else if (token == "perft")     is >> limits.perft;
+        else if (token == "solve")     limits.solve = 1;
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
+#ifdef BUGHOUSE
+    // Expected inflow over the given number of plies, at the rate of the pieces
+    // received so far in the game.
+    int horizon = Options["BughouseInflow"];
+    Eval::BughouseInflowKey = 0;
+    for (Color c : { WHITE, BLACK })
+        for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
+        {
+            Eval::BughouseInflow[c][pt] = pos.is_bughouse() ? 16 * Received[c][pt] * horizon / std::max(pos.game_ply(), 20) : 0;
+            Eval::BughouseInflowKey = make_key(Eval::BughouseInflowKey + Eval::BughouseInflow[c][pt]);
+        }
+#endif
+
+#ifdef USE_NNUE
+    Eval::NNUE::load();
+#endif
     Threads.start_thinking(pos, states, limits, ponderMode);
   }
 
 
+  // eval_paths() formats the counts of the paths taken by the evaluation
+
+  string eval_paths(const uint64_t paths[]) {
+
+    stringstream ss;
+
+    ss <<   "classical-psq "    << paths[Eval::CLASSICAL_PSQ]
+       << " classical-strong " << paths[Eval::CLASSICAL_STRONG]
+       << " nnue "             << paths[Eval::NNUE_ONLY]
+       << " nnue-variant "     << paths[Eval::NNUE_VARIANT];
+
+    return ss.str();
+  }
+
+
   // bench() is called when engine receives the "bench" command. Firstly
   // a list of UCI commands is setup according to bench parameters, then
   // it is run one by one printing a summary at the end.
@@ -238,7 +458,9 @@ namespace {
   void bench(Position& pos, istream& args, StateListPtr& states) {
 
     string token;
-    uint64_t num, nodes = 0, cnt = 1;
+    uint64_t num, nodes = 0, cnt = 1, evalProbes = 0, evalHits = 0;
+    uint64_t paths[Eval::EVAL_PATH_NB] = {};
+    vector<std::pair<string, std::pair<uint64_t, uint64_t>>> material; // Probes and hits by variant
 
     vector<string> list = setup_bench(pos, args);
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0 || s.find("eval") == 0; });
@@ -258,11 +480,25 @@ namespace {
                go(pos, is, states);
                Threads.main()->wait_for_search_finished();
                nodes += Threads.nodes_searched();
+
+               for (Thread* th : Threads)
+               {
+                   evalProbes += th->evalCache.probes, evalHits += th->evalCache.hits;
+                   material.back().second.first += th->materialProbes;
+                   material.back().second.second += th->materialHits;
+                   for (int i = 0; i < Eval::EVAL_PATH_NB; ++i)
+                       paths[i] += th->evalPaths[i];
+               }
             }
             else
                trace_eval(pos);
         }
-        else if (token == "setoption")  setoption(is);
+        else if (token == "setoption")
+        {
+            setoption(is);
+            if (material.empty() || material.back().first != string(Options["UCI_Variant"]))
+                material.emplace_back(string(Options["UCI_Variant"]), std::make_pair(0, 0));
+        }
         else if (token == "position")   position(pos, is, states);
         else if (token == "ucinewgame") { Search::clear(); elapsed = now(); } // Search::clear() may take some while
     }
@@ -275,6 +511,315 @@ namespace {
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
          << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+
+    if (evalProbes)
+        cerr << "Eval cache hits : " << evalHits << " of " << evalProbes << " evaluations ("
+             << std::fixed << std::setprecision(1) << 100.0 * evalHits / evalProbes << "%)" << endl;
+
+    for (const auto& m : material)
+        if (m.second.first)
+            cerr << "Material hits   : " << m.second.second << " of " << m.second.first << " probes ("
+                 << std::fixed << std::setprecision(1) << 100.0 * m.second.second / m.second.first
+                 << "%) in " << m.first << endl;
+
+#ifdef USE_NNUE
+    if (Eval::useNNUE)
+        cerr << "Eval paths      : " << eval_paths(paths) << endl;
+#endif
+  }
+
+#ifdef USE_NNUE
+  // nnue_bench() is called when engine receives the "nnue-bench" command. It
+  // times a single NNUE evaluation of each of the bench positions, with the
+  // accumulator refreshed and with the accumulator already computed, so that
+  // builds for different instruction sets can be compared.
+
+  void nnue_bench(Position& pos, istream& args, StateListPtr& states) {
+
+    Eval::NNUE::load();
+    if (!Eval::useNNUE)
+    {
+        sync_cout << "info string NNUE evaluation is not enabled" << sync_endl;
+        return;
+    }
+
+    constexpr int Count = 10000;
+    string token, settings = compiler_info();
+    size_t start = settings.find("Compilation settings");
+    double refresh = 0, update = 0;
+    int num = 0;
+
+    for (const auto& cmd : setup_bench(pos, args))
+    {
+        istringstream is(cmd);
+        is >> skipws >> token;
+
+        if (token == "setoption" && cmd.find("UCI_Variant") != string::npos)
+            setoption(is);
+        else if (token == "position")
+        {
+            position(pos, is, states);
+            auto t = Eval::NNUE::benchmark(pos, Count);
+            refresh += t.first, update += t.second, ++num;
+        }
+    }
+
+    cerr << "\n==========================="
+         << "\n" << settings.substr(start, settings.find('\n', start) - start)
+         << "\nPositions             : " << num
+         << "\nRefreshed eval (ns)   : " << (num ? refresh / num : 0)
+         << "\nUpdated eval (ns)     : " << (num ? update / num : 0) << endl;
+  }
+
+
+  // hybrid_bench() is called when engine receives the "hybrid-bench" command.
+  // It evaluates the positions of an EPD file, or the bench positions, with
+  // the NNUE thresholds of the variant, and reports the time per evaluation,
+  // the error from the NNUE evaluation and the paths taken, to compare the
+  // settings of the NNUEThreshold options.
+
+  void hybrid_bench(Position& pos, istream& args, StateListPtr& states) {
+
+    Eval::NNUE::load();
+    if (!Eval::useNNUE)
+    {
+        sync_cout << "info string NNUE evaluation is not enabled" << sync_endl;
+        return;
+    }
+
+    constexpr int Count = 1000;
+    string token, file, line;
+    vector<string> fens;
+    double time = 0, error = 0;
+    uint64_t* paths = Threads.main()->evalPaths;
+
+    // EPD lines keep the FEN fields, and drop the operations after them
+    if (args >> file)
+    {
+        ifstream in(file);
+        while (getline(in, line))
+        {
+            istringstream ls(line.substr(0, line.find(';')));
+            string fen, field;
+
+            for (int i = 0; ls >> field && (i < 4 || isdigit(field[0]) || field[0] == '+'); ++i)
+                fen += (i ? " " : "") + field;
+
+            if (!fen.empty())
+                fens.push_back("position fen " + fen);
+        }
+    }
+    else
+        fens = setup_bench(pos, args);
+
+    std::fill(paths, paths + Eval::EVAL_PATH_NB, 0);
+    int num = 0;
+
+    for (const auto& cmd : fens)
+    {
+        istringstream is(cmd);
+        is >> skipws >> token;
+
+        if (token == "setoption" && cmd.find("UCI_Variant") != string::npos)
+            setoption(is);
+        else if (token == "position")
+        {
+            position(pos, is, states);
+            if (pos.checkers())
+                continue;
+
+            auto r = Eval::hybrid_benchmark(pos, Count);
+            time += r.first, error += r.second, ++num;
+        }
+    }
+
+    cerr << "\n==========================="
+         << "\nPositions             : " << num
+         << "\nHybrid eval (ns)      : " << (num ? time / num : 0)
+         << "\nError from NNUE (cp)  : " << (num ? error / num * 100 / PawnValueEg : 0)
+         << "\nPaths                 : " << eval_paths(paths) << endl;
+  }
+#endif
+
+  // make_unmake() plays and takes back all the legal moves up to the given
+  // depth, and returns the number of moves played.
+
+  uint64_t make_unmake(Position& pos, Depth depth) {
+
+    StateInfo st;
+    uint64_t cnt = 0;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st, pos.gives_check(m));
+        cnt += 1 + (depth > 1 ? make_unmake(pos, depth - 1) : 0);
+        pos.undo_move(m);
+    }
+    return cnt;
+  }
+
+
+  // move_bench() is called when engine receives the "move-bench" command. It
+  // plays all the moves up to a small depth from the bench positions of the
+  // given variant, or of all of them, for at least half a second per variant,
+  // and reports the time per do_move() and undo_move() pair, move generation
+  // included.
+
+  void move_bench(Position& pos, istream& args, StateListPtr& states) {
+
+    constexpr Depth Depth = 3;
+    constexpr TimePoint MinTime = 500;
+    string token;
+    vector<std::pair<string, vector<string>>> variantFens;
+
+    for (const auto& cmd : setup_bench(pos, args))
+    {
+        istringstream is(cmd);
+        is >> skipws >> token;
+
+        if (token == "setoption" && cmd.find("UCI_Variant") != string::npos)
+        {
+            setoption(is);
+            if (variantFens.empty() || variantFens.back().first != string(Options["UCI_Variant"]))
+                variantFens.emplace_back(string(Options["UCI_Variant"]), vector<string>());
+        }
+        else if (token == "position" || cmd.find("UCI_Chess960") != string::npos)
+            variantFens.back().second.push_back(cmd);
+    }
+
+    cerr << "\n===========================";
+
+    for (const auto& vf : variantFens)
+    {
+        uint64_t moves = 0;
+        TimePoint elapsed = now(), end = elapsed + MinTime;
+
+        Options["UCI_Variant"] = vf.first;
+        do for (const string& cmd : vf.second)
+        {
+            istringstream is(cmd);
+            is >> token;
+
+            if (token == "setoption")
+                setoption(is);
+            else
+            {
+                position(pos, is, states);
+                moves += make_unmake(pos, Depth);
+            }
+        } while (now() < end);
+
+        elapsed = now() - elapsed;
+        cerr << "\n" << std::left << std::setw(20) << vf.first << ": "
+             << std::setw(10) << moves << " moves, "
+             << elapsed * 1000000.0 / std::max(moves, uint64_t(1)) << " ns/move";
+    }
+    cerr << endl;
+  }
+
+
+  // time_replay() is called when engine receives the "timereplay" command. It
+  // replays stored games, one "position ... moves ..." command per game, each
+  // optionally preceded by a "setoption name UCI_Variant" command, and simulates
+  // the clocks as if every move took the optimum time. The fixed and the adaptive
+  // move horizons are compared on the same games without playing any of them.
+
+  void time_replay(istream& args) {
+
+    string token, line;
+    string file = (args >> token) ? token : "games.txt";
+    TimePoint base = (args >> token) ? stoi(token) : 60000;
+    TimePoint inc  = (args >> token) ? stoi(token) : 0;
+
+    ifstream in(file);
+    if (!in.is_open())
+    {
+        cerr << "Unable to open file " << file << endl;
+        return;
+    }
+
+    struct Stats {
+      int flagged;
+      double horizonError, clockLeft;
+    } stats[2] = {}; // Fixed and adaptive horizon
+    int games = 0, plies = 0;
+
+    while (getline(in, line))
+    {
+        istringstream is(line);
+        is >> skipws >> token;
+
+        if (token == "setoption")
+            setoption(is);
+        if (token != "position")
+            continue;
+
+        Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+        string fen;
+        vector<string> moves;
+
+        is >> token;
+        if (token == "startpos")
+            fen = StartFENs[variant], is >> token;
+        else if (token == "fen")
+            while (is >> token && token != "moves")
+                fen += token + " ";
+        else
+            continue;
+
+        while (is >> token)
+            moves.push_back(token);
+
+        for (int adaptive : { 0, 1 })
+        {
+            TimeManagement tm = {};
+            tm.fixedHorizon = !adaptive;
+            TimePoint clock[COLOR_NB] = { base, base };
+            bool flagged = false;
+
+            Position pos;
+            StateListPtr states(new std::deque<StateInfo>(1));
+            pos.set(fen, Options["UCI_Chess960"], variant, &states->back(), Threads.main());
+
+            for (size_t i = 0; i < moves.size(); ++i)
+            {
+                Move m = UCI::to_move(pos, moves[i]);
+                if (m == MOVE_NONE)
+                    break;
+
+                Color us = pos.side_to_move();
+                Search::LimitsType limits;
+                limits.time[WHITE] = clock[WHITE], limits.time[BLACK] = clock[BLACK];
+                limits.inc[WHITE] = limits.inc[BLACK] = inc;
+                limits.startTime = now();
+
+                tm.init(pos, limits, us, pos.game_ply());
+                stats[adaptive].horizonError += abs(tm.move_horizon(pos) - int(moves.size() - i + 1) / 2);
+                clock[us] -= tm.optimum();
+                flagged |= clock[us] <= 0;
+                clock[us] += inc;
+                plies += adaptive;
+
+                states->emplace_back();
+                pos.do_move(m, states->back());
+            }
+
+            stats[adaptive].flagged += flagged;
+            stats[adaptive].clockLeft += 50.0 * (std::max(clock[WHITE], TimePoint(0)) + std::max(clock[BLACK], TimePoint(0))) / base;
+        }
+        ++games;
+    }
+
+    cerr << "\n==========================="
+         << "\nGames                 : " << games
+         << "\nMoves                 : " << plies;
+
+    for (int adaptive : { 0, 1 })
+        cerr << "\n" << (adaptive ? "Adaptive" : "Fixed") << " horizon"
+             << "\n  Horizon error (moves) : " << (plies ? stats[adaptive].horizonError / plies : 0)
+             << "\n  Flagged games         : " << stats[adaptive].flagged
+             << "\n  Clock left (%)        : " << (games ? stats[adaptive].clockLeft / games : 0);
+    cerr << endl;
   }
 
   // The win rate model returns the probability (per mille) of winning given an eval
@@ -299,6 +844,147 @@ namespace {
      return int(0.5 + 1000 / (1 + std::exp((a - x) / b)));
   }
 
+
+  // OutputWriter formats the structured search output on its own thread, the
+  // search threads only queue a copy of the information to be sent.
+
+  class OutputWriter {
+
+    struct Record {
+      UCI::PVInfo info;
+      Move best, ponder; // For "bestmove" records, with info.lines empty
+    };
+
+  public:
+    ~OutputWriter() {
+
+      {
+          std::lock_guard<std::mutex> lk(mutex);
+          exit = true;
+      }
+      cv.notify_all();
+
+      if (thread.joinable())
+          thread.join();
+    }
+
+    void push(UCI::PVInfo&& info, Move best = MOVE_NONE, Move ponder = MOVE_NONE) {
+
+      {
+          std::lock_guard<std::mutex> lk(mutex);
+
+          if (!thread.joinable())
+              thread = std::thread(&OutputWriter::idle_loop, this);
+
+          queue.push_back({ std::move(info), best, ponder });
+      }
+      cv.notify_all();
+    }
+
+    void wait() {
+
+      std::unique_lock<std::mutex> lk(mutex);
+      cv.wait(lk, [&]{ return queue.empty() && !writing; });
+    }
+
+    std::atomic<bool> enabled;
+
+  private:
+    void idle_loop() {
+
+      std::unique_lock<std::mutex> lk(mutex);
+
+      while (true)
+      {
+          cv.wait(lk, [&]{ return exit || !queue.empty(); });
+
+          if (queue.empty())
+              return;
+
+          Record r = std::move(queue.front());
+          queue.pop_front();
+          writing = true;
+          lk.unlock();
+
+          string s = r.info.lines.empty() ? json_bestmove(r) : json_pv(r.info);
+          sync_cout << s << sync_endl;
+
+          lk.lock();
+          writing = false;
+          cv.notify_all();
+      }
+    }
+
+    static string json_pv(const UCI::PVInfo& info) {
+
+      stringstream ss;
+
+      for (const auto& l : info.lines)
+      {
+          if (ss.rdbuf()->in_avail()) // Not at first line
+              ss << "\n";
+
+          ss << "{\"type\":\"info\""
+             << ",\"depth\":"    << l.depth
+             << ",\"seldepth\":" << l.selDepth
+             << ",\"multipv\":"  << l.multiPV
+             << ",\"score\":{";
+
+          if (abs(l.score) < VALUE_MATE_IN_MAX_PLY)
+              ss << "\"cp\":" << l.score * 100 / PawnValueEg;
+          else
+              ss << "\"mate\":" << (l.score > 0 ? VALUE_MATE - l.score + 1 : -VALUE_MATE - l.score - 1) / 2;
+
+          if (l.bound != BOUND_NONE)
+              ss << ",\"bound\":\"" << (l.bound == BOUND_LOWER ? "lower" : "upper") << "\"";
+
+          int w = win_rate_model( l.score, info.gamePly);
+          int b = win_rate_model(-l.score, info.gamePly);
+
+          ss << "},\"wdl\":["   << w << "," << 1000 - w - b << "," << b << "]"
+             << ",\"nodes\":"   << info.nodes
+             << ",\"nps\":"     << info.nodes * 1000 / info.time;
+
+          if (info.hashfull >= 0)
+              ss << ",\"hashfull\":" << info.hashfull;
+
+          ss << ",\"tbhits\":" << info.tbHits
+             << ",\"time\":"   << info.time
+             << ",\"pv\":[";
+
+          for (size_t i = 0; i < l.pv.size(); ++i)
+              ss << (i ? ",\"" : "\"") << UCI::move(l.pv[i], info.chess960) << "\"";
+
+          ss << "]}";
+      }
+
+      return ss.str();
+    }
+
+    static string json_bestmove(const Record& r) {
+
+      stringstream ss;
+
+      ss << "{\"type\":\"bestmove\",\"bestmove\":\"" << UCI::move(r.best, r.info.chess960) << "\"";
+
+      if (r.ponder != MOVE_NONE)
+          ss << ",\"ponder\":\"" << UCI::move(r.ponder, r.info.chess960) << "\"";
+
+      ss << "}";
+      return ss.str();
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Record> queue;
+    std::thread thread;
+    bool exit = false, writing = false;
+  } Output;
+
+  // Receivers of the search output in place of stdout, see Engine::Session
+  std::function<void(const UCI::PVInfo&)> InfoListener;
+  std::function<void(Move, Move)> BestMoveListener;
+
 } // namespace
 
 
@@ -347,16 +1033,69 @@ void UCI::loop(int argc, char* argv[]) {
       else if (token == "setoption")  setoption(is);
       else if (token == "go")         go(pos, is, states);
       else if (token == "position")   position(pos, is, states);
-      else if (token == "ucinewgame") Search::clear();
-      else if (token == "isready")    sync_cout << "readyok" << sync_endl;
+      else if (token == "ucinewgame")
+      {
+          if (Games.empty())
+              Search::clear();
+          else
+          {
+              Threads.main()->wait_for_search_finished();
+              Time.availableNodes = 0;
+              TT.clear();
+          }
+#ifdef BUGHOUSE
+          std::memset(Received, 0, sizeof(Received));
+#endif
+          LastSetup.fen.clear();
+          Bitbases::prepare(UCI::variant_from_name(Options["UCI_Variant"]));
+      }
+      else if (token == "game")       switch_game(is);
+      else if (token == "isready")
+      {
+#ifdef USE_NNUE
+          Eval::NNUE::load();
+#endif
+          Bitbases::prepare(UCI::variant_from_name(Options["UCI_Variant"]));
+          UCI::wait_for_output();
+          sync_cout << "readyok" << sync_endl;
+      }
 
       // Additional custom non-UCI commands, mainly for debugging.
       // Do not use these commands during a search!
-      else if (token == "flip")     pos.flip();
+      else if (token == "flip")     pos.flip(), LastSetup.fen.clear();
+#ifdef BUGHOUSE
+      else if (token == "holding")  holding(pos, is, false);
+      else if (token == "partner")  holding(pos, is, true);
+#endif
       else if (token == "bench")    bench(pos, is, states);
+#ifdef USE_NNUE
+      else if (token == "nnue-bench") nnue_bench(pos, is, states);
+      else if (token == "hybrid-bench") hybrid_bench(pos, is, states);
+#endif
+      else if (token == "move-bench") move_bench(pos, is, states);
+      else if (token == "timereplay") time_replay(is);
+      else if (token == "tune")
+      {
+          string sub;
+          if (is >> sub && sub == "spsa")
+              Tune::spsa(is);
+          else
+              sync_cout << "Unknown command: " << cmd << sync_endl;
+      }
+      else if (token == "match")    SelfPlay::match(is);
+      else if (token == "makebook") Book::build(is);
       else if (token == "d")        sync_cout << pos << sync_endl;
+      else if (token == "evalpaths")
+      {
+          uint64_t paths[Eval::EVAL_PATH_NB] = {};
+          for (Thread* th : Threads)
+              for (int i = 0; i < Eval::EVAL_PATH_NB; ++i)
+                  paths[i] += th->evalPaths[i];
+          sync_cout << "info string eval paths " << eval_paths(paths) << sync_endl;
+      }
       else if (token == "eval")     trace_eval(pos);
       else if (token == "compiler") sync_cout << compiler_info() << sync_endl;
+      else if (token == "startup-profile") sync_cout << Startup::profile() << sync_endl;
       else
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -402,6 +1141,127 @@ string UCI::wdl(Value v, int ply) {
 }
 
 
+/// UCI::send() sends the PV information to the GUI, formatted as UCI "info"
+/// lines on the calling thread, or queued to be formatted as JSON objects, one
+/// per line, when the "OutputFormat" option is set to "json".
+
+void UCI::send(PVInfo&& info) {
+
+  if (InfoListener)
+  {
+      InfoListener(info);
+      return;
+  }
+
+  if (Output.enabled)
+  {
+      Output.push(std::move(info));
+      return;
+  }
+
+  stringstream ss;
+
+  for (const auto& l : info.lines)
+  {
+      if (ss.rdbuf()->in_avail()) // Not at first line
+          ss << "\n";
+
+      ss << "info"
+         << " depth "    << l.depth
+         << " seldepth " << l.selDepth
+         << " multipv "  << l.multiPV
+         << " score "    << UCI::value(l.score);
+
+      if (Options["UCI_ShowWDL"])
+          ss << UCI::wdl(l.score, info.gamePly);
+
+      ss << (l.bound == BOUND_LOWER ? " lowerbound" : l.bound == BOUND_UPPER ? " upperbound" : "");
+
+      ss << " nodes "    << info.nodes
+         << " nps "      << info.nodes * 1000 / info.time;
+
+      if (info.hashfull >= 0)
+          ss << " hashfull " << info.hashfull;
+
+      ss << " tbhits "   << info.tbHits
+         << " time "     << info.time
+         << " pv";
+
+      for (Move m : l.pv)
+          ss << " " << UCI::move(m, info.chess960);
+  }
+
+  sync_cout << ss.str() << sync_endl;
+}
+
+
+/// UCI::send_bestmove() sends the best move, and the move to ponder on if any,
+/// after the PV information still queued.
+
+void UCI::send_bestmove(Move best, Move ponder, bool chess960) {
+
+  if (BestMoveListener)
+  {
+      BestMoveListener(best, ponder);
+      return;
+  }
+
+  if (Output.enabled)
+  {
+      PVInfo info {};
+      info.chess960 = chess960;
+      Output.push(std::move(info), best, ponder);
+      return;
+  }
+
+  sync_cout << "bestmove " << UCI::move(best, chess960);
+
+  if (ponder != MOVE_NONE)
+      std::cout << " ponder " << UCI::move(ponder, chess960);
+
+  std::cout << sync_endl;
+}
+
+
+/// UCI::set_listeners() redirects the search output to the given functions,
+/// called on the main search thread, or back to stdout when they are empty.
+
+void UCI::set_listeners(std::function<void(const PVInfo&)> onInfo, std::function<void(Move, Move)> onBestMove) {
+
+  InfoListener = onInfo;
+  BestMoveListener = onBestMove;
+}
+
+
+/// UCI::set_output_format() selects the format of the search output, and
+/// UCI::wait_for_output() waits until all the queued output has been sent.
+
+void UCI::set_output_format(const string& format) {
+
+  if (format != "json")
+      Output.wait();
+
+  Output.enabled = format == "json";
+}
+
+void UCI::wait_for_output() {
+  Output.wait();
+}
+
+
+/// UCI::resize_hash() is called when the "Hash" option changes. In server mode
+/// it is the budget of the hash tables of all the games, and the least recently
+/// used games are freed to fit in it; otherwise it is the size of the TT.
+
+void UCI::resize_hash(size_t mb) {
+
+  if (Games.empty())
+      TT.resize(mb);
+  else
+      free_games(0);
+}
+
+
 /// UCI::square() converts a Square to a string in algebraic notation (g1, a7, etc.)
 
 std::string UCI::square(Square s) {
@@ -457,6 +1317,151 @@ Move UCI::to_move(const Position& pos, string& str) {
 }
 
 
+/// UCI::san() converts a legal move to Standard Algebraic Notation (Nf3, exd5,
+/// O-O, e8=Q, N@f7), as used in PGN.
+
+string UCI::san(Position& pos, Move m) {
+
+  string s;
+  Square from = from_sq(m), to = to_sq(m);
+  PieceType pt = type_of(pos.moved_piece(m));
+
+  if (type_of(m) == CASTLING)
+      s = to > from ? "O-O" : "O-O-O";
+#ifdef CRAZYHOUSE
+  else if (type_of(m) == DROP)
+      s = string(1, " PNBRQK"[pt]) + "@" + UCI::square(to);
+#endif
+  else
+  {
+      if (pt == PAWN)
+      {
+          if (pos.capture(m))
+              s = char('a' + file_of(from));
+      }
+      else
+      {
+          bool ambiguous = false, sameFile = false, sameRank = false;
+
+          for (const auto& other : MoveList<LEGAL>(pos))
+              if (   other != m
+                  && to_sq(other) == to
+                  && type_of(other) != CASTLING
+#ifdef CRAZYHOUSE
+                  && type_of(other) != DROP
+#endif
+                  && type_of(pos.moved_piece(other)) == pt)
+              {
+                  ambiguous = true;
+                  sameFile |= file_of(from_sq(other)) == file_of(from);
+                  sameRank |= rank_of(from_sq(other)) == rank_of(from);
+              }
+
+          s = " PNBRQK"[pt];
+          if (ambiguous && (!sameFile || sameRank))
+              s += char('a' + file_of(from));
+          if (ambiguous && sameFile)
+              s += char('1' + rank_of(from));
+      }
+
+      if (pos.capture(m))
+          s += 'x';
+
+      s += UCI::square(to);
+
+      if (type_of(m) == PROMOTION)
+          s += string("=") + " PNBRQK"[promotion_type(m)];
+  }
+
+  StateInfo st;
+  pos.do_move(m, st);
+  if (pos.checkers())
+      s += MoveList<LEGAL>(pos).size() ? "+" : "#";
+  pos.undo_move(m);
+
+  return s;
+}
+
+
+/// UCI::san_to_move() converts a move in Standard Algebraic Notation to the
+/// corresponding legal Move, if any. Annotations and check marks are ignored,
+/// and so are superfluous disambiguations.
+
+Move UCI::san_to_move(const Position& pos, string str) {
+
+  str = str.substr(0, str.find_last_not_of("+#!?") + 1);
+  std::replace(str.begin(), str.end(), '0', 'O');
+
+  if (str.size() < 2)
+      return MOVE_NONE;
+
+  bool castling = str == "O-O" || str == "O-O-O";
+  PieceType pt = PAWN, promotion = NO_PIECE_TYPE;
+  size_t pc = string(" PNBRQK").find(str[0]);
+
+  if (!castling && pc != string::npos && pc > 0)
+      pt = PieceType(pc), str.erase(0, 1);
+
+#ifdef CRAZYHOUSE
+  bool drop = !str.empty() && str[0] == '@';
+  if (drop)
+      str.erase(0, 1);
+#endif
+
+  if (!castling && str.size() > 2 && string("NBRQK").find(str.back()) != string::npos)
+  {
+      promotion = PieceType(string(" PNBRQK").find(str.back()));
+      str.pop_back();
+      if (str.back() == '=')
+          str.pop_back();
+  }
+
+  if (!castling && (str.size() < 2 || str[str.size() - 2] < 'a' || str[str.size() - 2] > 'h'))
+      return MOVE_NONE;
+
+  Square to = castling ? SQ_NONE : make_square(File(str[str.size() - 2] - 'a'), Rank(str[str.size() - 1] - '1'));
+  string hints = castling ? "" : str.substr(0, str.size() - 2);
+  Move found = MOVE_NONE;
+
+  for (const auto& m : MoveList<LEGAL>(pos))
+  {
+      if (castling)
+      {
+          if (type_of(m) == CASTLING && (to_sq(m) > from_sq(m)) == (str == "O-O"))
+              return m;
+          continue;
+      }
+
+#ifdef CRAZYHOUSE
+      if ((type_of(m) == DROP) != drop)
+          continue;
+#endif
+
+      if (   type_of(m) == CASTLING
+          || to_sq(m) != to
+          || type_of(pos.moved_piece(m)) != pt
+          || (type_of(m) == PROMOTION ? promotion_type(m) : NO_PIECE_TYPE) != promotion)
+          continue;
+
+      bool match = true;
+      for (char c : hints)
+          if (c >= 'a' && c <= 'h')
+              match &= from_sq(m) != SQ_NONE && file_of(from_sq(m)) == File(c - 'a');
+          else if (c >= '1' && c <= '8')
+              match &= from_sq(m) != SQ_NONE && rank_of(from_sq(m)) == Rank(c - '1');
+
+      if (match)
+      {
+          if (found)
+              return MOVE_NONE; // Ambiguous
+          found = m;
+      }
+  }
+
+  return found;
+}
+
+
 Variant UCI::variant_from_name(const string& str) {
 
   for (Variant v = CHESS_VARIANT; v < SUBVARIANT_NB; ++v)
@@ -465,3 +1470,10 @@ Variant UCI::variant_from_name(const string& str) {
 
   return CHESS_VARIANT;
 }
+
+
+/// UCI::start_fen() returns the FEN string of the starting position of a variant
+
+string UCI::start_fen(Variant v) {
+  return StartFENs[v];
+}
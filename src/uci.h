@@ -19,6 +19,7 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -67,15 +68,45 @@ private:
   OnChange on_change;
 };
 
+/// PVInfo holds the search information sent to the GUI with the PV lines, so
+/// that the structured output can be formatted away from the search threads.
+struct PVInfo {
+
+  struct Line {
+    size_t multiPV;
+    Depth depth;
+    int selDepth;
+    Value score;
+    Bound bound; // Only for the line currently searched, when out of the window
+    std::vector<Move> pv;
+  };
+
+  std::vector<Line> lines;
+  uint64_t nodes, tbHits;
+  int64_t time;
+  int hashfull; // Negative when not computed yet
+  int gamePly;
+  bool chess960;
+};
+
 void init(OptionsMap&);
 void loop(int argc, char* argv[]);
 std::string value(Value v);
 std::string square(Square s);
 std::string move(Move m, bool chess960);
-std::string pv(const Position& pos, Depth depth, Value alpha, Value beta);
+void pv(const Position& pos, Depth depth, Value alpha, Value beta);
+void send(PVInfo&& info);
+void send_bestmove(Move best, Move ponder, bool chess960);
+void set_listeners(std::function<void(const PVInfo&)> onInfo, std::function<void(Move, Move)> onBestMove);
+void set_output_format(const std::string& format);
+void resize_hash(size_t mb);
+void wait_for_output();
 std::string wdl(Value v, int ply);
 Move to_move(const Position& pos, std::string& str);
+std::string san(Position& pos, Move m);
+Move san_to_move(const Position& pos, std::string str);
 Variant variant_from_name(const std::string& str);
+std::string start_fen(Variant v);
 
 } // namespace UCI
 
@@ -22,10 +22,10 @@
 #include <sstream>
 
 #include "evaluate.h"
+#include "book.h"
 #include "misc.h"
 #include "search.h"
 #include "thread.h"
-#include "tt.h"
 #include "uci.h"
 #include "syzygy/tbprobe.h"
 
@@ -37,14 +37,35 @@ namespace UCI {
 
 /// 'On change' actions, triggered by an option's value change
 void on_clear_hash(const Option&) { Search::clear(); }
-void on_hash_size(const Option& o) { TT.resize(size_t(o)); }
+void on_hash_size(const Option& o) { UCI::resize_hash(size_t(o)); }
 void on_logger(const Option& o) { start_logger(o); }
 void on_threads(const Option& o) { Threads.set(size_t(o)); }
+void on_output_format(const Option& o) { UCI::set_output_format(o); }
 void on_tb_path(const Option& o) { Tablebases::init(UCI::variant_from_name(Options["UCI_Variant"]), o); }
+void on_bitbase_path(const Option& o) {
+  Bitbases::set_path(o);
+  Bitbases::prepare(UCI::variant_from_name(Options["UCI_Variant"]));
+}
+void on_book_file(const Option& o) { Book::init(o); }
 #ifdef USE_NNUE
 void on_use_NNUE(const Option& ) { Eval::NNUE::init(); }
 void on_eval_file(const Option& ) { Eval::NNUE::init(); }
+void on_shared_NNUE(const Option& ) { Eval::eval_file_loaded = "None"; Eval::NNUE::init(); }
+Eval::HybridParams& hybrid() { return Eval::Hybrid[main_variant(UCI::variant_from_name(Options["UCI_Variant"]))]; }
+void on_threshold1(const Option& o) { hybrid().threshold1 = int(o); Eval::update_hybrid_key(); }
+void on_threshold2(const Option& o) { hybrid().threshold2 = int(o); Eval::update_hybrid_key(); }
+void on_strong_classical(const Option& o) { hybrid().strongClassical = int(o); Eval::update_hybrid_key(); }
+#endif
+
+// The hybrid thresholds are kept by variant, show the ones of the new variant
+void on_variant(const Option& ) {
+#ifdef USE_NNUE
+  const Eval::HybridParams hp = hybrid();
+  Options["NNUEThreshold1"] = std::to_string(hp.threshold1);
+  Options["NNUEThreshold2"] = std::to_string(hp.threshold2);
+  Options["NNUEStrongClassical"] = std::to_string(hp.strongClassical);
 #endif
+}
 
 /// Our case insensitive less() function as required by UCI protocol
 bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const {
@@ -65,15 +86,19 @@ void init(OptionsMap& o) {
   o["Analysis Contempt"]     << Option("Both", {"Both", "Off", "White", "Black"});
   o["Threads"]               << Option(1, 1, 512, on_threads);
   o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
+  o["GameHash"]              << Option(16, 1, MaxHashMB);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["EvalCache"]             << Option(1, 0, 1024, on_clear_hash);
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
+  o["Joint MultiPV"]         << Option(false);
+  o["OutputFormat"]          << Option("text", {"text", "json"}, on_output_format);
   o["Skill Level"]           << Option(20, -20, 20);
   o["Move Overhead"]         << Option(10, 0, 5000);
   o["Slow Mover"]            << Option(100, 10, 1000);
   o["nodestime"]             << Option(0, 0, 10000);
   o["UCI_Chess960"]          << Option(false);
-  o["UCI_Variant"]           << Option(variants.front().c_str(), variants);
+  o["UCI_Variant"]           << Option(variants.front().c_str(), variants, on_variant);
   o["UCI_AnalyseMode"]       << Option(false);
   o["UCI_LimitStrength"]     << Option(false);
   o["UCI_Elo"]               << Option(1350, 0, 3000);
@@ -82,9 +107,22 @@ void init(OptionsMap& o) {
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(7, 0, 7);
+  o["BitbasePath"]           << Option("<empty>", on_bitbase_path);
+  o["SolveHash"]             << Option(64, 1, MaxHashMB);
+  o["SolveTree"]             << Option("<empty>");
+  o["OwnBook"]               << Option(false);
+  o["BookFile"]              << Option("<empty>", on_book_file);
+  o["BestBookMove"]          << Option(false);
+#ifdef BUGHOUSE
+  o["BughouseInflow"]        << Option(0, 0, 100);
+#endif
 #ifdef USE_NNUE
   o["Use NNUE"]              << Option(true, on_use_NNUE);
   o["EvalFile"]              << Option(EvalFileDefaultName, on_eval_file);
+  o["SharedNNUE"]            << Option(false, on_shared_NNUE);
+  o["NNUEThreshold1"]        << Option(682, 0, 10000, on_threshold1);
+  o["NNUEThreshold2"]        << Option(176, 0, 10000, on_threshold2);
+  o["NNUEStrongClassical"]   << Option(2 * RookValueMg, 0, 20000, on_strong_classical);
 #endif
 }
 